@@ -0,0 +1,136 @@
+/* arena.h
+ * Copyright (c) 2013, Peter Ohler
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *  - Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ *  - Neither the name of Peter Ohler nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef __OJ_ARENA_H__
+#define __OJ_ARENA_H__
+
+#include "ruby.h"
+
+#define ARENA_BLOCK	4096
+
+// Small blocks needed during a parse, such as unescaped keys and class
+// names, are carved out of an arena and all released together when the
+// parse is done instead of being freed one at a time.
+typedef struct _ArenaBlock {
+    struct _ArenaBlock	*next;
+    size_t		size;
+    char		data[8];
+} *ArenaBlock;
+
+typedef struct _Arena {
+    ArenaBlock	blocks;
+    ArenaBlock	spare;	// standard block kept by arena_reset()
+    char	*cur;
+    char	*end;
+    char	base[1024];
+} *Arena;
+
+inline static void
+arena_init(Arena a) {
+    a->blocks = 0;
+    a->spare = 0;
+    a->cur = a->base;
+    a->end = a->base + sizeof(a->base);
+}
+
+inline static void
+arena_cleanup(Arena a) {
+    ArenaBlock	b;
+
+    while (0 != (b = a->blocks)) {
+	a->blocks = b->next;
+	xfree(b);
+    }
+    if (0 != a->spare) {
+	xfree(a->spare);
+	a->spare = 0;
+    }
+}
+
+// Releases everything allocated so far but holds on to one standard block
+// so an arena that is reset over and over does not allocate each time.
+inline static void
+arena_reset(Arena a) {
+    ArenaBlock	b;
+
+    while (0 != (b = a->blocks)) {
+	a->blocks = b->next;
+	if (0 == a->spare && ARENA_BLOCK == b->size) {
+	    a->spare = b;
+	} else {
+	    xfree(b);
+	}
+    }
+    a->cur = a->base;
+    a->end = a->base + sizeof(a->base);
+}
+
+inline static void*
+arena_alloc(Arena a, size_t size) {
+    char	*p;
+
+    // keep everything aligned for pointers and VALUEs
+    size = (size + 7) & ~(size_t)7;
+    if ((size_t)(a->end - a->cur) < size) {
+	ArenaBlock	b;
+
+	if (ARENA_BLOCK < size) {
+	    b = (ArenaBlock)ALLOC_N(char, sizeof(struct _ArenaBlock) - sizeof(b->data) + size);
+	    b->size = size;
+	} else if (0 != a->spare) {
+	    b = a->spare;
+	    a->spare = 0;
+	} else {
+	    b = (ArenaBlock)ALLOC_N(char, sizeof(struct _ArenaBlock) - sizeof(b->data) + ARENA_BLOCK);
+	    b->size = ARENA_BLOCK;
+	}
+	b->next = a->blocks;
+	a->blocks = b;
+	a->cur = b->data;
+	a->end = b->data + b->size;
+    }
+    p = a->cur;
+    a->cur += size;
+
+    return p;
+}
+
+inline static char*
+arena_strndup(Arena a, const char *s, size_t len) {
+    char	*d = (char*)arena_alloc(a, len + 1);
+
+    memcpy(d, s, len);
+    d[len] = '\0';
+
+    return d;
+}
+
+#endif /* __OJ_ARENA_H__ */
@@ -45,22 +45,21 @@ hash_set_cstr(ParseInfo pi, const char *key, size_t klen, const char *str, size_
 	*pi->options.create_id == *key &&
 	pi->options.create_id_len == klen &&
 	0 == strncmp(pi->options.create_id, key, klen)) {
-	if (str < pi->json || pi->cur < str) {
-	    parent->classname = oj_strndup(str, len);
-	} else {
-	    parent->classname = str;
-	}
+	parent->classname = arena_strndup(&pi->arena, str, len);
 	parent->clen = len;
     } else {
-	VALUE	rstr = rb_str_new(str, len);
-	VALUE	rkey = rb_str_new(key, klen);
+	VALUE	rstr = oj_cstr_to_value(pi, str, len);
+	VALUE	rkey;
 
-	rstr = oj_encode(rstr);
-	rkey = oj_encode(rkey);
 	if (Yes == pi->options.sym_key) {
-	    rkey = rb_str_intern(rkey);
+	    rkey = oj_sym_cache_get(key, klen);
+	} else if (Yes == pi->options.cache_keys) {
+	    rkey = oj_key_cache_get(key, klen);
+	} else {
+	    rkey = rb_str_freeze(oj_encode(rb_str_new(key, klen)));
 	}
-	rb_hash_aset(parent->val, rkey, rstr);
+	stack_add(&pi->stack, rkey);
+	stack_add(&pi->stack, rstr);
     }
 }
 
@@ -68,6 +67,7 @@ static void
 end_hash(struct _ParseInfo *pi) {
     Val	parent = stack_peek(&pi->stack);
 
+    parent->val = oj_stack_hash(&pi->stack, FIX2LONG(parent->val));
     if (0 != parent->classname) {
 	VALUE	clas;
 
@@ -75,10 +75,7 @@ end_hash(struct _ParseInfo *pi) {
 	if (Qundef != clas) { // else an error
 	    parent->val = rb_funcall(clas, oj_json_create_id, 1, parent->val);
 	}
-	if (parent->classname < pi->json || pi->cur < parent->classname) {
-	    xfree((char*)parent->classname);
-	    parent->classname = 0;
-	}
+	parent->classname = 0;
     }
 }
 
@@ -96,11 +93,11 @@ oj_compat_parse(int argc, VALUE *argv, VALUE self) {
     pi.options = oj_default_options;
     oj_set_compat_callbacks(&pi);
 
-    return oj_pi_parse(argc, argv, &pi, 0);
+    return oj_pi_parse(argc, argv, &pi, 0, 0);
 }
 
 VALUE
-oj_compat_parse_cstr(int argc, VALUE *argv, char *json) {
+oj_compat_parse_cstr(int argc, VALUE *argv, char *json, size_t len) {
     struct _ParseInfo	pi;
 
     pi.options = oj_default_options;
@@ -108,5 +105,5 @@ oj_compat_parse_cstr(int argc, VALUE *argv, char *json) {
     pi.end_hash = end_hash;
     pi.hash_set_cstr = hash_set_cstr;
 
-    return oj_pi_parse(argc, argv, &pi, json);
+    return oj_pi_parse(argc, argv, &pi, json, len);
 }
@@ -39,6 +39,8 @@
 #include <math.h>
 
 #include "oj.h"
+#include "simd.h"
+#include "num.h"
 #include "cache8.h"
 #include "odd.h"
 
@@ -93,8 +95,6 @@ static void	dump_obj_attrs(VALUE obj, VALUE clas, slot_t id, int depth, Out out)
 static void	dump_odd(VALUE obj, Odd odd, VALUE clas, int depth, Out out);
 
 static void	grow(Out out, size_t len);
-static size_t	hibit_friendly_size(const uint8_t *str, size_t len);
-static size_t	ascii_friendly_size(const uint8_t *str, size_t len);
 
 static void	dump_leaf(Leaf leaf, int depth, Out out);
 static void	dump_leaf_str(Leaf leaf, Out out);
@@ -128,26 +128,6 @@ static char	ascii_friendly_chars[256] = "\
 33333333333333333333333333333333\
 33333333333333333333333333333333";
 
-inline static size_t
-hibit_friendly_size(const uint8_t *str, size_t len) {
-    size_t	size = 0;
-
-    for (; 0 < len; str++, len--) {
-	size += hibit_friendly_chars[*str];
-    }
-    return size - len * (size_t)'0';
-}
-
-inline static size_t
-ascii_friendly_size(const uint8_t *str, size_t len) {
-    size_t	size = 0;
-
-    for (; 0 < len; str++, len--) {
-	size += ascii_friendly_chars[*str];
-    }
-    return size - len * (size_t)'0';
-}
-
 inline static void
 fill_indent(Out out, int cnt) {
     if (0 < out->indent) {
@@ -159,36 +139,70 @@ fill_indent(Out out, int cnt) {
     }
 }
 
-inline static const char*
-ulong2str(uint32_t num, char *end) {
-    char	*b;
-
-    *end-- = '\0';
-    for (b = end; 0 < num || b == end; num /= 10, b--) {
-	*b = (num % 10) + '0';
+// Digits are written two at a time from this table.
+static const char	digit_pairs[201] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+static const uint64_t	pow10_u64[20] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+    10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL,
+    100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+    100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+    100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL
+};
+
+// Returns the number of digits in num. The bit length times log10(2), as
+// 1233 / 4096, is the count or one more, and a single compare settles it.
+// The low bit is set so 0 counts as one digit, no power of 10 over 1 is odd
+// so the count is otherwise unchanged.
+inline static int
+ulong_len(uint64_t num) {
+    uint64_t	n = num | 1;
+    int		bits;
+    int		t;
+
+#if defined(__GNUC__)
+    bits = 64 - __builtin_clzll(n);
+#else
+    for (bits = 0; bits < 64 && 0 != (n >> bits); bits++) {
     }
-    b++;
+#endif
+    t = (bits * 1233) >> 12;
 
-    return b;
+    return t + 1 - (n < pow10_u64[t]);
 }
 
+// Writes the digits of num so the last one is just before end.
 inline static void
-dump_ulong(unsigned long num, Out out) {
-    char	buf[32];
-    char	*b = buf + sizeof(buf) - 1;
-
-    *b-- = '\0';
-    if (0 < num) {
-	for (; 0 < num; num /= 10, b--) {
-	    *b = (num % 10) + '0';
-	}
-	b++;
+ulong_fill(uint64_t num, char *end) {
+    const char	*p;
+
+    while (100 <= num) {
+	p = digit_pairs + (num % 100) * 2;
+	num /= 100;
+	*--end = p[1];
+	*--end = p[0];
+    }
+    if (10 <= num) {
+	p = digit_pairs + num * 2;
+	*--end = p[1];
+	*--end = p[0];
     } else {
-	*b = '0';
-    }
-    for (; '\0' != *b; b++) {
-	*out->cur++ = *b;
+	*--end = (char)('0' + num);
     }
+}
+
+// The caller makes sure there is room for the digits.
+inline static void
+dump_ulong(unsigned long num, Out out) {
+    int	len = ulong_len(num);
+
+    ulong_fill(num, out->cur + len);
+    out->cur += len;
     *out->cur = '\0';
 }
 
@@ -362,34 +376,18 @@ dump_false(Out out) {
 
 static void
 dump_fixnum(VALUE obj, Out out) {
-    char	buf[32];
-    char	*b = buf + sizeof(buf) - 1;
     long	num = NUM2LONG(obj);
-    int		neg = 0;
+    uint64_t	u = (0 > num) ? -(uint64_t)num : (uint64_t)num;
+    int		len = ulong_len(u) + (0 > num);
 
-    if (0 > num) {
-	neg = 1;
-	num = -num;
-    }
-    *b-- = '\0';
-    if (0 < num) {
-	for (; 0 < num; num /= 10, b--) {
-	    *b = (num % 10) + '0';
-	}
-	if (neg) {
-	    *b = '-';
-	} else {
-	    b++;
-	}
-    } else {
-	*b = '0';
-    }
-    if (out->end - out->cur <= (long)(sizeof(buf) - (b - buf))) {
-	grow(out, sizeof(buf) - (b - buf));
+    if (out->end - out->cur <= len) {
+	grow(out, len);
     }
-    for (; '\0' != *b; b++) {
-	*out->cur++ = *b;
+    if (0 > num) {
+	*out->cur = '-';
     }
+    ulong_fill(u, out->cur + len);
+    out->cur += len;
     *out->cur = '\0';
 }
 
@@ -427,10 +425,17 @@ dump_float(VALUE obj, Out out) {
     } else if (-OJ_INFINITY == d) {
 	strcpy(buf, "-Infinity");
 	cnt = 9;
+    } else if (0 == out->opts->float_prec && d == d) { // d != d for NaN
+	if (out->end - out->cur <= 32) {
+	    grow(out, 32);
+	}
+	out->cur += oj_dtoa(d, out->cur);
+	*out->cur = '\0';
+	return;
     } else if (d == (double)(long long int)d) {
 	cnt = sprintf(buf, "%.1f", d); // used sprintf due to bug in snprintf
     } else {
-	cnt = sprintf(buf, "%0.15g", d); // used sprintf due to bug in snprintf
+	cnt = sprintf(buf, "%0.*g", out->opts->float_prec, d); // used sprintf due to bug in snprintf
     }
     if (out->end - out->cur <= (long)cnt) {
 	grow(out, cnt);
@@ -441,20 +446,60 @@ dump_float(VALUE obj, Out out) {
     *out->cur = '\0';
 }
 
+// Writes the escaped form of the character at str. Returns the last
+// character used, more than one for multibyte unicode.
+static const char*
+dump_escaped(const char *str, const char *end, const char *cmap, Out out) {
+    switch (cmap[(uint8_t)*str]) {
+    case '1':
+	*out->cur++ = *str;
+	break;
+    case '2':
+	*out->cur++ = '\\';
+	switch (*str) {
+	case '\b':	*out->cur++ = 'b';	break;
+	case '\t':	*out->cur++ = 't';	break;
+	case '\n':	*out->cur++ = 'n';	break;
+	case '\f':	*out->cur++ = 'f';	break;
+	case '\r':	*out->cur++ = 'r';	break;
+	default:	*out->cur++ = *str;	break;
+	}
+	break;
+    case '3': // Unicode
+	str = dump_unicode(str, end, out);
+	break;
+    case '6': // control characters
+	*out->cur++ = '\\';
+	*out->cur++ = 'u';
+	*out->cur++ = '0';
+	*out->cur++ = '0';
+	dump_hex((uint8_t)*str, out);
+	break;
+    default:
+	break; // ignore, should never happen if the table is correct
+    }
+    return str;
+}
+
+// Runs of characters that do not need escaping are found with a vector scan
+// and copied as a block. Room is made for the rest of the string as if it
+// had no escapes and checked again at each escape, which can write at most
+// 12 characters.
 static void
 dump_cstr(const char *str, size_t cnt, int is_sym, int escape1, Out out) {
-    size_t	size;
-    char	*cmap;
+    const char	*end = str + cnt;
+    const char	*cmap;
+    const char*	(*scan)(const char *s, const char *end);
 
     if (Yes == out->opts->ascii_only) {
 	cmap = ascii_friendly_chars;
-	size = ascii_friendly_size((uint8_t*)str, cnt);
+	scan = oj_scan_escape_ascii;
     } else {
 	cmap = hibit_friendly_chars;
-	size = hibit_friendly_size((uint8_t*)str, cnt);
+	scan = oj_scan_escape;
     }
-    if (out->end - out->cur <= (long)size + 10) { // extra 10 for escaped first char, quotes, and sym
-	grow(out, size + 10);
+    if (out->end - out->cur <= (long)cnt + 10) { // extra 10 for escaped first char, quotes, and sym
+	grow(out, cnt + 10);
     }
     *out->cur++ = '"';
     if (escape1) {
@@ -463,57 +508,26 @@ dump_cstr(const char *str, size_t cnt, int is_sym, int escape1, Out out) {
 	*out->cur++ = '0';
 	*out->cur++ = '0';
 	dump_hex((uint8_t)*str, out);
-	cnt--;
-	size--;
 	str++;
 	is_sym = 0; // just to make sure
     }
-    if (cnt == size) {
-	if (is_sym) {
-	    *out->cur++ = ':';
-	}
-	for (; '\0' != *str; str++) {
-	    *out->cur++ = *str;
-	}
-	*out->cur++ = '"';
-    } else {
-	const char	*end = str + cnt;
+    if (is_sym) {
+	*out->cur++ = ':';
+    }
+    while (str < end) {
+	const char	*s = scan(str, end);
 
-	if (is_sym) {
-	    *out->cur++ = ':';
+	memcpy(out->cur, str, s - str);
+	out->cur += s - str;
+	if (end <= s) {
+	    break;
 	}
-	for (; str < end; str++) {
-	    switch (cmap[(uint8_t)*str]) {
-	    case '1':
-		*out->cur++ = *str;
-		break;
-	    case '2':
-		*out->cur++ = '\\';
-		switch (*str) {
-		case '\b':	*out->cur++ = 'b';	break;
-		case '\t':	*out->cur++ = 't';	break;
-		case '\n':	*out->cur++ = 'n';	break;
-		case '\f':	*out->cur++ = 'f';	break;
-		case '\r':	*out->cur++ = 'r';	break;
-		default:	*out->cur++ = *str;	break;
-		}
-		break;
-	    case '3': // Unicode
-		str = dump_unicode(str, end, out);
-		break;
-	    case '6': // control characters
-		*out->cur++ = '\\';
-		*out->cur++ = 'u';
-		*out->cur++ = '0';
-		*out->cur++ = '0';
-		dump_hex((uint8_t)*str, out);
-		break;
-	    default:
-		break; // ignore, should never happen if the table is correct
-	    }
+	if (out->end - out->cur <= (long)(end - s) + 16) {
+	    grow(out, (end - s) + 16);
 	}
-	*out->cur++ = '"';
+	str = dump_escaped(s, end, cmap, out) + 1;
     }
+    *out->cur++ = '"';
     *out->cur = '\0';
 }
 
@@ -29,6 +29,10 @@ dflags = {
   'HAS_EXCEPTION_MAGIC' => ('ruby' == type && ('1' == version[0] && '9' == version[1])) ? 0 : 1,
   'HAS_PROC_WITH_BLOCK' => ('ruby' == type && (('1' == version[0] && '9' == version[1]) || '2' <= version[0])) ? 1 : 0,
   'HAS_GC_GUARD' => ('jruby' != type && 'rubinius' != type) ? 1 : 0,
+  'HAS_DYNAMIC_SYMBOLS' => ('ruby' == type && ('3' <= version[0] || ('2' == version[0] && '2' <= version[1]))) ? 1 : 0,
+  'HAS_HASH_BULK_INSERT' => ('ruby' == type && ('3' <= version[0] || ('2' == version[0] && '6' <= version[1]))) ? 1 : 0,
+  'HAS_HASH_NEW_CAPA' => ('ruby' == type && ('4' <= version[0] || ('3' == version[0] && '2' <= version[1]))) ? 1 : 0,
+  'HAS_NOGVL' => (!is_windows && 'ruby' == type && '2' <= version[0]) ? 1 : 0,
   'HAS_TOP_LEVEL_ST_H' => ('ree' == type || ('ruby' == type &&  '1' == version[0] && '8' == version[1])) ? 1 : 0,
   'IS_WINDOWS' => is_windows ? 1 : 0,
   'SAFE_CACHE' => is_windows ? 0 : 1,
@@ -39,6 +39,10 @@
 
 #include "oj.h"
 #include "encode.h"
+#include "simd.h"
+#include "num.h"
+#include "mapped_file.h"
+#include "hash.h"
 
 // maximum to allocate on the stack, arbitrary limit
 #define SMALL_XML	65536
@@ -57,6 +61,7 @@ typedef struct _Doc {
     Leaf		*where;	     // points to current location
     Leaf		where_path[MAX_STACK]; // points to head of path
     char		*json;
+    size_t		map_len;     // json is mmap()ed when not 0
     unsigned long	size;	     // number of leaves/branches in the doc
     VALUE		self;
     Batch		batches;
@@ -88,11 +93,11 @@ static Leaf	read_true(ParseInfo pi);
 static Leaf	read_false(ParseInfo pi);
 static Leaf	read_nil(ParseInfo pi);
 static void	next_non_white(ParseInfo pi);
-static char*	read_quoted_value(ParseInfo pi);
+static char*	read_quoted_value(ParseInfo pi, uint32_t *lenp);
 static void	skip_comment(ParseInfo pi);
 
 static VALUE	protect_open_proc(VALUE x);
-static VALUE	parse_json(VALUE clas, char *json, int given, int allocated);
+static VALUE	parse_json(VALUE clas, char *json, int given, int allocated, size_t map_len);
 static void	each_leaf(Doc doc, VALUE self);
 static int	move_step(Doc doc, const char *path, int loc);
 static Leaf	get_doc_leaf(Doc doc, const char *path);
@@ -130,20 +135,15 @@ char *stpcpy(char *dest, const char *src) {
 
 inline static void
 next_non_white(ParseInfo pi) {
-    for (; 1; pi->s++) {
-	switch(*pi->s) {
-	case ' ':
-	case '\t':
-	case '\f':
-	case '\n':
-	case '\r':
-	    break;
-	case '/':
-	    skip_comment(pi);
-	    break;
-	default:
+    while (1) {
+	pi->s = (char*)oj_skip_white(pi->s);
+	if ('/' != *pi->s) {
 	    return;
 	}
+	skip_comment(pi);
+	if ('\0' != *pi->s) {
+	    pi->s++;
+	}
     }
 }
 
@@ -184,6 +184,18 @@ ulong_fill(char *s, size_t num) {
     return s;
 }
 
+// Lengths are kept in 32 bits to keep leaves small. A longer string is
+// measured up to its terminator instead.
+inline static uint32_t
+len32(size_t len) {
+    return (UINT32_MAX <= len) ? UINT32_MAX : (uint32_t)len;
+}
+
+inline static size_t
+leaf_len(const char *s, uint32_t len) {
+    return (UINT32_MAX == len) ? strlen(s) : (size_t)len;
+}
+
 inline static void
 leaf_init(Leaf leaf, int type) {
     leaf->next = 0;
@@ -266,7 +278,7 @@ leaf_value(Doc doc, Leaf leaf) {
 	    leaf_float_value(leaf);
 	    break;
 	case T_STRING:
-	    leaf->value = rb_str_new2(leaf->str);
+	    leaf->value = rb_str_new(leaf->str, leaf_len(leaf->str, leaf->len));
 	    leaf->value = oj_encode(leaf->value);
 	    leaf->value_type = RUBY_VAL;
 	    break;
@@ -365,7 +377,6 @@ leaf_fixnum_value(Leaf leaf) {
     leaf->value_type = RUBY_VAL;
 }
 
-#ifdef JRUBY_RUBY
 static void
 leaf_float_value(Leaf leaf) {
     char	*s = leaf->str;
@@ -389,55 +400,41 @@ leaf_float_value(Leaf leaf) {
 	    big = 1;
 	}
     }
-    if (big) {
-	char	c = *s;
-	
-	*s = '\0';
-	leaf->value = rb_cstr_to_inum(leaf->str, 10, 0);
-	*s = c;
-    } else {
-	double	d;
-
-	if ('.' == *s) {
-	    s++;
-	    for (; '0' <= *s && *s <= '9'; s++) {
-		a = a * 10 + (*s - '0');
-		div *= 10;
+    if ('.' == *s) {
+	s++;
+	for (; '0' <= *s && *s <= '9'; s++) {
+	    a = a * 10 + (*s - '0');
+	    div *= 10;
+	    if (NUM_MAX <= div) {
+		big = 1;
 	    }
 	}
-	if ('e' == *s || 'E' == *s) {
+    }
+    if ('e' == *s || 'E' == *s) {
+	s++;
+	if ('-' == *s) {
+	    s++;
+	    eneg = 1;
+	} else if ('+' == *s) {
 	    s++;
-	    if ('-' == *s) {
-		s++;
-		eneg = 1;
-	    } else if ('+' == *s) {
-		s++;
-	    }
-	    for (; '0' <= *s && *s <= '9'; s++) {
-		e = e * 10 + (*s - '0');
-	    }
-	}
-	d = (double)n + (double)a / (double)div;
-	if (neg) {
-	    d = -d;
 	}
-	if (0 != e) {
-	    if (eneg) {
-		e = -e;
+	for (; '0' <= *s && *s <= '9'; s++) {
+	    e = e * 10 + (*s - '0');
+	    if (NUM_MAX <= e) {
+		big = 1;
 	    }
-	    d *= pow(10.0, e);
 	}
-	leaf->value = rb_float_new(d);
+    }
+    if (big) {
+	leaf->value = rb_float_new(rb_cstr_to_dbl(leaf->str, 1));
+    } else {
+	if (eneg) {
+	    e = -e;
+	}
+	leaf->value = rb_float_new(oj_num_to_double(neg, n, a, div, e, leaf->str, s - leaf->str));
     }
     leaf->value_type = RUBY_VAL;
 }
-#else
-static void
-leaf_float_value(Leaf leaf) {
-    leaf->value = rb_float_new(rb_cstr_to_dbl(leaf->str, 1));
-    leaf->value_type = RUBY_VAL;
-}
-#endif
 
 static VALUE
 leaf_array_value(Doc doc, Leaf leaf) {
@@ -465,7 +462,7 @@ leaf_hash_value(Doc doc, Leaf leaf) {
 	VALUE	key;
 
 	do {
-	    key = rb_str_new2(e->key);
+	    key = rb_str_new(e->key, leaf_len(e->key, e->klen));
 	    key = oj_encode(key);
 	    rb_hash_aset(h, key, leaf_value(doc, e));
 	    e = e->next;
@@ -529,6 +526,7 @@ read_obj(ParseInfo pi) {
     Leaf	h = leaf_new(pi->doc, T_HASH);
     char	*end;
     const char	*key = 0;
+    uint32_t	klen = 0;
     Leaf	val = 0;
 
     pi->s++;
@@ -541,7 +539,7 @@ read_obj(ParseInfo pi) {
 	next_non_white(pi);
 	key = 0;
 	val = 0;
-	if ('"' != *pi->s || 0 == (key = read_quoted_value(pi))) {
+	if ('"' != *pi->s || 0 == (key = read_quoted_value(pi, &klen))) {
 	    raise_error("unexpected character", pi->str, pi->s);
 	}
 	next_non_white(pi);
@@ -556,6 +554,7 @@ read_obj(ParseInfo pi) {
 	}
 	end = pi->s;
 	val->key = key;
+	val->klen = klen;
 	val->parent_type = T_HASH;
 	leaf_append_element(h, val);
 	next_non_white(pi);
@@ -616,7 +615,7 @@ static Leaf
 read_str(ParseInfo pi) {
     Leaf	leaf = leaf_new(pi->doc, T_STRING);
 
-    leaf->str = read_quoted_value(pi);
+    leaf->str = read_quoted_value(pi, &leaf->len);
 
     return leaf;
 }
@@ -640,6 +639,7 @@ read_num(ParseInfo pi) {
 	}
     }
     if ('e' == *pi->s || 'E' == *pi->s) {
+	type = T_FLOAT;
 	pi->s++;
 	if ('-' == *pi->s || '+' == *pi->s) {
 	    pi->s++;
@@ -721,18 +721,52 @@ read_hex(ParseInfo pi, char *h) {
     return (char)b;
 }
 
+// Reads the four hex digits of a \u escape.
+static uint32_t
+read_code(ParseInfo pi, char *h) {
+    return ((uint32_t)(uint8_t)read_hex(pi, h) << 8) | (uint8_t)read_hex(pi, h + 2);
+}
+
+// Writes code as UTF-8 at t and returns the position of the last byte
+// written.
+static char*
+code_to_utf8(char *t, uint32_t code) {
+    if (0x0000007F >= code) {
+	*t = (char)code;
+    } else if (0x000007FF >= code) {
+	*t++ = (char)(0xC0 | (code >> 6));
+	*t = (char)(0x80 | (0x3F & code));
+    } else if (0x0000FFFF >= code) {
+	*t++ = (char)(0xE0 | (code >> 12));
+	*t++ = (char)(0x80 | ((code >> 6) & 0x3F));
+	*t = (char)(0x80 | (0x3F & code));
+    } else {
+	*t++ = (char)(0xF0 | (code >> 18));
+	*t++ = (char)(0x80 | ((code >> 12) & 0x3F));
+	*t++ = (char)(0x80 | ((code >> 6) & 0x3F));
+	*t = (char)(0x80 | (0x3F & code));
+    }
+    return t;
+}
+
 /* Assume the value starts immediately and goes until the quote character is
- * reached again. Do not read the character after the terminating quote.
+ * reached again. Do not read the character after the terminating quote. The
+ * value is unescaped in place and its length, which counts any '\0' from a
+ * \u0000, is set in lenp.
  */
 static char*
-read_quoted_value(ParseInfo pi) {
+read_quoted_value(ParseInfo pi, uint32_t *lenp) {
     char	*value = 0;
     char	*h = pi->s; // head
     char	*t = h;	    // tail
+    uint32_t	code;
+    uint32_t	c2;
     
     h++;	// skip quote character
     t++;
     value = h;
+    h = (char*)oj_scan_string(h); // skip the leading plain run in one step
+    t = h;
     for (; '"' != *h; h++, t++) {
 	if ('\0' == *h) {
 	    pi->s = h;
@@ -749,25 +783,35 @@ read_quoted_value(ParseInfo pi) {
 	    case '/':	*t = '/';	break;
 	    case '\\':	*t = '\\';	break;
 	    case 'u':
-		h++;
-		*t = read_hex(pi, h);
-		h += 2;
-		if ('\0' != *t) {
-		    t++;
+		// a UTF-8 sequence is never longer than the escape it replaces
+		code = read_code(pi, h + 1);
+		h += 4;
+		if (0x0000D800 <= code && code <= 0x0000DFFF) {
+		    if ('\\' != *(h + 1) || 'u' != *(h + 2)) {
+			pi->s = h + 1;
+			raise_error("invalid escaped character", pi->str, pi->s);
+		    }
+		    c2 = read_code(pi, h + 3);
+		    h += 6;
+		    code = ((((code - 0x0000D800) & 0x000003FF) << 10) | ((c2 - 0x0000DC00) & 0x000003FF)) + 0x00010000;
 		}
-		*t = read_hex(pi, h);
-		h++;
+		t = code_to_utf8(t, code);
 		break;
 	    default:
 		pi->s = h;
 		raise_error("invalid escaped character", pi->str, pi->s);
 		break;
 	    }
-	} else if (t != h) {
-	    *t = *h;
+	} else {
+	    char	*e = (char*)oj_scan_string(h);
+
+	    memmove(t, h, e - h);
+	    t += e - h - 1;
+	    h = e - 1;
 	}
     }
     *t = '\0'; // terminate value
+    *lenp = len32(t - value);
     pi->s = h + 1;
 
     return value;
@@ -782,6 +826,7 @@ doc_init(Doc doc) {
     doc->self = Qundef;
     doc->size = 0;
     doc->json = 0;
+    doc->map_len = 0;
     doc->batches = &doc->batch0;
     doc->batch0.next = 0;
     doc->batch0.next_avail = 0;
@@ -815,18 +860,46 @@ protect_open_proc(VALUE x) {
     return Qnil;
 }
 
+// Releases the document text whether it was allocated or mapped.
+static void
+free_json(char *json, size_t map_len) {
+    struct _MappedFile	mf;
+
+    mf.json = json;
+    mf.len = 0;
+    mf.map_len = map_len;
+    oj_file_close(&mf);
+}
+
 static void
 free_doc_cb(void *x) {
     Doc	doc = (Doc)x;
 
     if (0 != doc) {
-	xfree(doc->json);
+	free_json(doc->json, doc->map_len);
 	doc_free(doc);
     }
 }
 
+// The ParseInfo is on the stack of the caller and marks where the parse
+// starts.
+static void
+set_stack_min(ParseInfo pi) {
+#if IS_WINDOWS
+    pi->stack_min = (void*)((char*)pi - (512 * 1024)); // assume a 1M stack and give half to ruby
+#else
+    struct rlimit	lim;
+
+    if (0 == getrlimit(RLIMIT_STACK, &lim)) {
+	pi->stack_min = (void*)((char*)pi - (lim.rlim_cur / 4 * 3)); // let 3/4ths of the stack be used only
+    } else {
+	pi->stack_min = 0; // indicates not to check stack limit
+    }
+#endif
+}
+
 static VALUE
-parse_json(VALUE clas, char *json, int given, int allocated) {
+parse_json(VALUE clas, char *json, int given, int allocated, size_t map_len) {
     struct _ParseInfo	pi;
     VALUE		result = Qnil;
     Doc			doc;
@@ -846,23 +919,12 @@ parse_json(VALUE clas, char *json, int given, int allocated) {
     pi.s = pi.str;
     doc_init(doc);
     pi.doc = doc;
-#if IS_WINDOWS
-    pi.stack_min = (void*)((char*)&pi - (512 * 1024)); // assume a 1M stack and give half to ruby
-#else
-    {
-	struct rlimit	lim;
-
-	if (0 == getrlimit(RLIMIT_STACK, &lim)) {
-	    pi.stack_min = (void*)((char*)&lim - (lim.rlim_cur / 4 * 3)); // let 3/4ths of the stack be used only
-	} else {
-	    pi.stack_min = 0; // indicates not to check stack limit
-	}
-    }
-#endif
+    set_stack_min(&pi);
     // last arg is free func void* func(void*)
     doc->self = rb_data_object_alloc(clas, doc, 0, free_doc_cb);
     rb_gc_register_address(&doc->self);
     doc->json = json;
+    doc->map_len = map_len;
     DATA_PTR(doc->self) = doc;
     result = rb_protect(protect_open_proc, (VALUE)&pi, &ex);
     if (given || 0 != ex) {
@@ -870,7 +932,7 @@ parse_json(VALUE clas, char *json, int given, int allocated) {
 	DATA_PTR(doc->self) = 0;
 	doc_free(pi.doc);
 	if (allocated && 0 != ex) { // will jump so caller will not free
-	    xfree(json);
+	    free_json(json, map_len);
 	}
     } else {
 	result = doc->self;
@@ -1147,7 +1209,7 @@ doc_open(VALUE clas, VALUE str) {
 	json = ALLOCA_N(char, len);
     }
     memcpy(json, StringValuePtr(str), len);
-    obj = parse_json(clas, json, given, allocate);
+    obj = parse_json(clas, json, given, allocate, 0);
     if (given && allocate) {
 	xfree(json);
     }
@@ -1174,38 +1236,17 @@ doc_open(VALUE clas, VALUE str) {
  */
 static VALUE
 doc_open_file(VALUE clas, VALUE filename) {
-    char	*path;
-    char	*json;
-    FILE	*f;
-    size_t	len;
-    VALUE	obj;
-    int		given = rb_block_given_p();
-    int		allocate;
+    struct _MappedFile	mf;
+    VALUE		obj;
+    int			given = rb_block_given_p();
 
     Check_Type(filename, T_STRING);
-    path = StringValuePtr(filename);
-    if (0 == (f = fopen(path, "r"))) {
-	rb_raise(rb_eIOError, "%s", strerror(errno));
-    }
-    fseek(f, 0, SEEK_END);
-    len = ftell(f);
-    allocate = (SMALL_XML < len || !given);
-    if (allocate) {
-	json = ALLOC_N(char, len + 1);
-    } else {
-	json = ALLOCA_N(char, len + 1);
-    }
-    fseek(f, 0, SEEK_SET);
-    if (len != fread(json, 1, len, f)) {
-	fclose(f);
-	rb_raise(rb_const_get_at(Oj, rb_intern("LoadError")), 
-		 "Failed to read %lu bytes from %s.", (unsigned long)len, path);
-    }
-    fclose(f);
-    json[len] = '\0';
-    obj = parse_json(clas, json, given, allocate);
-    if (given && allocate) {
-	xfree(json);
+    // The parser writes into the text so a private mapping is used. Pages are
+    // only copied as they are written to.
+    oj_file_open(&mf, StringValuePtr(filename), 1, 1);
+    obj = parse_json(clas, mf.json, given, 1, mf.map_len);
+    if (given) {
+	oj_file_close(&mf);
     }
     return obj;
 }
@@ -1271,7 +1312,7 @@ doc_local_key(VALUE self) {
     VALUE	key = Qnil;
 
     if (T_HASH == leaf->parent_type) {
-	key = rb_str_new2(leaf->key);
+	key = rb_str_new(leaf->key, leaf_len(leaf->key, leaf->klen));
 	key = oj_encode(key);
     } else if (T_ARRAY == leaf->parent_type) {
 	key = LONG2NUM(leaf->index);
@@ -1625,11 +1666,525 @@ doc_close(VALUE self) {
     rb_gc_unregister_address(&doc->self);
     DATA_PTR(doc->self) = 0;
     if (0 != doc) {
-	xfree(doc->json);
+	free_json(doc->json, doc->map_len);
 	doc_free(doc);
     }
     return Qnil;
 }
+// Lazy loading. Oj.load() with :lazy parses into the same leaves as an
+// Oj::Doc and returns proxies for the Arrays and Hashes in the document.
+// Ruby values are only made for the leaves that are actually read. The
+// document is held by a hidden object that every proxy marks so it is freed
+// when the last proxy is collected.
+
+typedef struct _LazyDoc {
+    struct _Doc	doc;
+    VALUE	vals;	    // Ruby values cached in leaves, held for the GC
+    char	sym_key;    // YesNo
+    char	cache_keys; // YesNo
+    char	bigdec_load; // YesNo
+} *LazyDoc;
+
+typedef struct _LazyVal {
+    VALUE	lazy_doc;
+    Leaf	leaf;
+} *LazyVal;
+
+VALUE	oj_lazy_array_class = Qundef;
+VALUE	oj_lazy_hash_class = Qundef;
+
+static void
+lazy_doc_mark(void *ptr) {
+    if (0 != ptr) {
+	rb_gc_mark(((LazyDoc)ptr)->vals);
+    }
+}
+
+static void
+lazy_doc_free(void *ptr) {
+    LazyDoc	ld = (LazyDoc)ptr;
+
+    if (0 != ld) {
+	xfree(ld->doc.json);
+	doc_free(&ld->doc);
+	xfree(ld);
+    }
+}
+
+static void
+lazy_val_mark(void *ptr) {
+    rb_gc_mark(((LazyVal)ptr)->lazy_doc);
+}
+
+inline static LazyVal
+self_lazy(VALUE self) {
+    return (LazyVal)DATA_PTR(self);
+}
+
+inline static LazyDoc
+lazy_doc(LazyVal lv) {
+    return (LazyDoc)DATA_PTR(lv->lazy_doc);
+}
+
+static VALUE
+lazy_key(LazyDoc ld, Leaf leaf) {
+    size_t	klen = leaf_len(leaf->key, leaf->klen);
+
+    if (Yes == ld->sym_key) {
+	return oj_sym_cache_get(leaf->key, klen);
+    }
+    if (Yes == ld->cache_keys) {
+	return oj_key_cache_get(leaf->key, klen);
+    }
+    return rb_str_freeze(oj_encode(rb_str_new(leaf->key, klen)));
+}
+
+// Returns non-zero if the key of leaf is the klen bytes at key.
+inline static int
+lazy_key_eq(Leaf leaf, const char *key, size_t klen) {
+    return klen == leaf_len(leaf->key, leaf->klen) && 0 == memcmp(key, leaf->key, klen);
+}
+
+// Converts a number leaf with the same Integer, Float, and BigDecimal rules
+// Oj.load follows. The Oj::Doc conversions differ on exponents and long
+// fractions.
+static VALUE
+lazy_num(LazyDoc ld, Leaf leaf) {
+    struct _NumInfo	ni;
+
+    oj_num_read(&ni, leaf->str, leaf->str + strlen(leaf->str));
+    if (Yes == ld->bigdec_load) {
+	ni.big = 1;
+    }
+    leaf->value = oj_num_as_value(&ni);
+    leaf->value_type = RUBY_VAL;
+
+    return leaf->value;
+}
+
+// Returns a proxy for an Array or Hash leaf or the Ruby value of any other
+// leaf. Values are made once and kept in the leaf.
+static VALUE
+lazy_value(VALUE lazy_doc, Leaf leaf) {
+    LazyVal	lv;
+    VALUE	v;
+
+    switch (leaf->type) {
+    case T_ARRAY:
+	v = Data_Make_Struct(oj_lazy_array_class, struct _LazyVal, lazy_val_mark, -1, lv);
+	break;
+    case T_HASH:
+	v = Data_Make_Struct(oj_lazy_hash_class, struct _LazyVal, lazy_val_mark, -1, lv);
+	break;
+    default:
+	if (RUBY_VAL != leaf->value_type) {
+	    if (T_FIXNUM == leaf->type || T_FLOAT == leaf->type) {
+		v = lazy_num((LazyDoc)DATA_PTR(lazy_doc), leaf);
+	    } else {
+		v = leaf_value(&((LazyDoc)DATA_PTR(lazy_doc))->doc, leaf);
+	    }
+	    if (!SPECIAL_CONST_P(v)) {
+		rb_ary_push(((LazyDoc)DATA_PTR(lazy_doc))->vals, v);
+	    }
+	    return v;
+	}
+	return leaf->value;
+    }
+    lv->lazy_doc = lazy_doc;
+    lv->leaf = leaf;
+
+    return v;
+}
+
+// Builds the Ruby Array or Hash for a leaf and everything under it.
+static VALUE
+lazy_build(VALUE lazy_doc, Leaf leaf) {
+    VALUE	v;
+    Leaf	first;
+    Leaf	e;
+
+    switch (leaf->type) {
+    case T_ARRAY:
+	v = rb_ary_new();
+	break;
+    case T_HASH:
+	v = rb_hash_new();
+	break;
+    default:
+	return lazy_value(lazy_doc, leaf);
+    }
+    if (0 != leaf->elements) {
+	first = leaf->elements->next;
+	e = first;
+	do {
+	    if (T_ARRAY == leaf->type) {
+		rb_ary_push(v, lazy_build(lazy_doc, e));
+	    } else {
+		rb_hash_aset(v, lazy_key((LazyDoc)DATA_PTR(lazy_doc), e), lazy_build(lazy_doc, e));
+	    }
+	    e = e->next;
+	} while (e != first);
+    }
+    return v;
+}
+
+VALUE
+oj_lazy_load(VALUE input, VALUE ropts) {
+    struct _ParseInfo	pi;
+    struct _Options	copts = oj_default_options;
+    LazyDoc		ld;
+    VALUE		self;
+    const char		*start;
+    const char		*end;
+    size_t		len;
+
+    oj_parse_options(ropts, &copts);
+    if (!RB_TYPE_P(input, T_STRING)) {
+	input = rb_funcall2(input, oj_read_id, 0, 0);
+    }
+    Check_Type(input, T_STRING);
+    start = StringValuePtr(input);
+    end = start + RSTRING_LEN(input);
+    oj_parse_slice(ropts, &start, &end);
+    len = end - start;
+
+    self = Data_Make_Struct(0, struct _LazyDoc, lazy_doc_mark, lazy_doc_free, ld);
+    doc_init(&ld->doc);
+    ld->vals = Qnil;
+    ld->sym_key = copts.sym_key;
+    ld->cache_keys = copts.cache_keys;
+    ld->bigdec_load = copts.bigdec_load;
+    ld->doc.json = ALLOC_N(char, len + 1);
+    memcpy(ld->doc.json, start, len);
+    ld->doc.json[len] = '\0';
+    ld->vals = rb_ary_new();
+    RB_GC_GUARD(input);
+
+    pi.str = ld->doc.json;
+    if (3 <= len && 0xEF == (uint8_t)*pi.str && 0xBB == (uint8_t)pi.str[1] && 0xBF == (uint8_t)pi.str[2]) {
+	pi.str += 3;
+    }
+    pi.s = pi.str;
+    pi.doc = &ld->doc;
+    set_stack_min(&pi);
+    ld->doc.data = read_next(&pi);
+    if (0 == ld->doc.data) {
+	raise_error("Empty input", pi.str, pi.s);
+    }
+    next_non_white(&pi);
+    if ('\0' != *pi.s) {
+	raise_error("unexpected characters after the JSON document", pi.str, pi.s);
+    }
+    return lazy_value(self, ld->doc.data);
+}
+
+/* call-seq: [](key) => Object
+ *
+ * Returns the value for key, a String or Symbol, or nil if there is no such
+ * key. Arrays and Hashes are returned as Oj::LazyArray and Oj::LazyHash.
+ * @param [String|Symbol] key key of the value to return
+ */
+static VALUE
+lazy_hash_aref(VALUE self, VALUE key) {
+    LazyVal	lv = self_lazy(self);
+    Leaf	found = 0;
+    const char	*k;
+    size_t	klen;
+
+    if (T_SYMBOL == rb_type(key)) {
+	key = rb_sym2str(key);
+    }
+    Check_Type(key, T_STRING);
+    k = RSTRING_PTR(key);
+    klen = RSTRING_LEN(key);
+    if (0 != lv->leaf->elements) {
+	Leaf	first = lv->leaf->elements->next;
+	Leaf	e = first;
+
+	// the last of duplicate keys wins as it would in a Hash
+	do {
+	    if (lazy_key_eq(e, k, klen)) {
+		found = e;
+	    }
+	    e = e->next;
+	} while (e != first);
+    }
+    if (0 == found) {
+	return Qnil;
+    }
+    return lazy_value(lv->lazy_doc, found);
+}
+
+/* call-seq: key?(key) => true or false
+ *
+ * Returns true if the Hash has the key.
+ * @param [String|Symbol] key key to look for
+ */
+static VALUE
+lazy_hash_has_key(VALUE self, VALUE key) {
+    LazyVal	lv = self_lazy(self);
+    const char	*k;
+    size_t	klen;
+
+    if (T_SYMBOL == rb_type(key)) {
+	key = rb_sym2str(key);
+    }
+    Check_Type(key, T_STRING);
+    k = RSTRING_PTR(key);
+    klen = RSTRING_LEN(key);
+    if (0 != lv->leaf->elements) {
+	Leaf	first = lv->leaf->elements->next;
+	Leaf	e = first;
+
+	do {
+	    if (lazy_key_eq(e, k, klen)) {
+		return Qtrue;
+	    }
+	    e = e->next;
+	} while (e != first);
+    }
+    return Qfalse;
+}
+
+// Returns a Hash of the distinct keys in the order they first appear. When
+// values is set each key has the value of its last pair, as in a Hash built
+// from the document.
+static VALUE
+lazy_hash_pairs(LazyVal lv, int values) {
+    VALUE	h = rb_hash_new();
+
+    if (0 != lv->leaf->elements) {
+	Leaf	first = lv->leaf->elements->next;
+	Leaf	e = first;
+
+	do {
+	    rb_hash_aset(h, lazy_key(lazy_doc(lv), e), values ? lazy_value(lv->lazy_doc, e) : Qtrue);
+	    e = e->next;
+	} while (e != first);
+    }
+    return h;
+}
+
+/* call-seq: keys() => Array
+ *
+ * Returns the keys of the Hash. A duplicated key is only included once.
+ */
+static VALUE
+lazy_hash_keys(VALUE self) {
+    return rb_funcall(lazy_hash_pairs(self_lazy(self), 0), rb_intern("keys"), 0);
+}
+
+static int
+yield_pair(VALUE key, VALUE value, VALUE x) {
+    rb_yield_values(2, key, value);
+
+    return ST_CONTINUE;
+}
+
+/* call-seq: each() { |key, value| ... } => self
+ *
+ * Yields each key and value of the Hash. A duplicated key is only yielded
+ * once, with its last value.
+ */
+static VALUE
+lazy_hash_each(VALUE self) {
+    RETURN_ENUMERATOR(self, 0, 0);
+    rb_hash_foreach(lazy_hash_pairs(self_lazy(self), 1), yield_pair, Qnil);
+
+    return self;
+}
+
+/* call-seq: [](index) => Object
+ *
+ * Returns the element at index or nil if index is out of range. A negative
+ * index counts back from the end. Arrays and Hashes are returned as
+ * Oj::LazyArray and Oj::LazyHash.
+ * @param [Fixnum] index index of the element to return
+ */
+static VALUE
+lazy_array_aref(VALUE self, VALUE index) {
+    LazyVal	lv = self_lazy(self);
+    long	i = NUM2LONG(index);
+    long	cnt = (0 == lv->leaf->elements) ? 0 : (long)lv->leaf->elements->index;
+    Leaf	e;
+
+    if (0 > i) {
+	i += cnt;
+    }
+    if (0 > i || cnt <= i) {
+	return Qnil;
+    }
+    for (e = lv->leaf->elements->next; 0 < i; i--) {
+	e = e->next;
+    }
+    return lazy_value(lv->lazy_doc, e);
+}
+
+/* call-seq: each() { |value| ... } => self
+ *
+ * Yields each element of the Array.
+ */
+static VALUE
+lazy_array_each(VALUE self) {
+    LazyVal	lv = self_lazy(self);
+
+    RETURN_ENUMERATOR(self, 0, 0);
+    if (0 != lv->leaf->elements) {
+	Leaf	first = lv->leaf->elements->next;
+	Leaf	e = first;
+
+	do {
+	    rb_yield(lazy_value(lv->lazy_doc, e));
+	    e = e->next;
+	} while (e != first);
+    }
+    return self;
+}
+
+/* call-seq: size() => Fixnum
+ *
+ * Returns the number of elements in the Array or pairs in the Hash.
+ */
+static VALUE
+lazy_size(VALUE self) {
+    LazyVal	lv = self_lazy(self);
+    long	cnt = 0;
+
+    if (0 != lv->leaf->elements) {
+	if (T_ARRAY == lv->leaf->type) {
+	    cnt = (long)lv->leaf->elements->index;
+	} else {
+	    // duplicated keys only count once
+	    return rb_funcall(lazy_hash_pairs(lv, 0), rb_intern("size"), 0);
+	}
+    }
+    return LONG2NUM(cnt);
+}
+
+/* call-seq: empty?() => true or false
+ *
+ * Returns true if there are no elements.
+ */
+static VALUE
+lazy_empty(VALUE self) {
+    return (0 == self_lazy(self)->leaf->elements) ? Qtrue : Qfalse;
+}
+
+/* call-seq: dig(key, ...) => Object
+ *
+ * Returns the value found by looking up each key in turn or nil if one of
+ * them is missing.
+ * @param [String|Symbol|Fixnum] key Hash key or Array index
+ */
+static VALUE
+lazy_dig(int argc, VALUE *argv, VALUE self) {
+    VALUE	v = self;
+    int		i;
+
+    if (1 > argc) {
+	rb_raise(rb_eArgError, "Wrong number of arguments to dig().");
+    }
+    for (i = 0; i < argc; i++) {
+	if (oj_lazy_hash_class == rb_obj_class(v)) {
+	    v = lazy_hash_aref(v, argv[i]);
+	} else if (oj_lazy_array_class == rb_obj_class(v)) {
+	    v = lazy_array_aref(v, argv[i]);
+	} else if (Qnil == v) {
+	    return Qnil;
+	} else {
+	    return rb_funcall2(v, rb_intern("dig"), argc - i, argv + i);
+	}
+    }
+    return v;
+}
+
+/* call-seq: materialize() => Array or Hash
+ *
+ * Returns a plain Array or Hash with everything under it, as Oj.load would
+ * have without :lazy.
+ */
+static VALUE
+lazy_materialize(VALUE self) {
+    LazyVal	lv = self_lazy(self);
+
+    return lazy_build(lv->lazy_doc, lv->leaf);
+}
+
+/* call-seq: ==(other) => true or false
+ *
+ * Compares the materialized value with other.
+ */
+static VALUE
+lazy_eql(VALUE self, VALUE other) {
+    VALUE	clas = rb_obj_class(other);
+
+    if (oj_lazy_hash_class == clas || oj_lazy_array_class == clas) {
+	other = lazy_materialize(other);
+    }
+    return rb_equal(lazy_materialize(self), other);
+}
+
+/* call-seq: inspect() => String
+ *
+ * Returns the inspect String of the materialized value.
+ */
+static VALUE
+lazy_inspect(VALUE self) {
+    return rb_inspect(lazy_materialize(self));
+}
+
+/* Document-class: Oj::LazyHash
+ *
+ * A read only view of a JSON object returned by Oj.load with the :lazy
+ * option. Nothing under it is converted to Ruby until it is read.
+ *
+ * @example
+ *   h = Oj.load(%{{"id":7,"user":{"name":"Ann"},"items":[1,2]}}, :lazy => true)
+ *   h['id']                #=> 7
+ *   h.dig('user', 'name')  #=> "Ann"
+ *   h['items'].to_a        #=> [1, 2]
+ */
+/* Document-class: Oj::LazyArray
+ *
+ * A read only view of a JSON array returned by Oj.load with the :lazy
+ * option. Nothing under it is converted to Ruby until it is read.
+ */
+void
+oj_init_lazy() {
+    oj_lazy_hash_class = rb_define_class_under(Oj, "LazyHash", rb_cObject);
+    rb_undef_alloc_func(oj_lazy_hash_class);
+    rb_include_module(oj_lazy_hash_class, rb_mEnumerable);
+    rb_define_method(oj_lazy_hash_class, "[]", lazy_hash_aref, 1);
+    rb_define_method(oj_lazy_hash_class, "key?", lazy_hash_has_key, 1);
+    rb_define_method(oj_lazy_hash_class, "has_key?", lazy_hash_has_key, 1);
+    rb_define_method(oj_lazy_hash_class, "include?", lazy_hash_has_key, 1);
+    rb_define_method(oj_lazy_hash_class, "keys", lazy_hash_keys, 0);
+    rb_define_method(oj_lazy_hash_class, "each", lazy_hash_each, 0);
+    rb_define_method(oj_lazy_hash_class, "each_pair", lazy_hash_each, 0);
+    rb_define_method(oj_lazy_hash_class, "size", lazy_size, 0);
+    rb_define_method(oj_lazy_hash_class, "length", lazy_size, 0);
+    rb_define_method(oj_lazy_hash_class, "empty?", lazy_empty, 0);
+    rb_define_method(oj_lazy_hash_class, "dig", lazy_dig, -1);
+    rb_define_method(oj_lazy_hash_class, "to_h", lazy_materialize, 0);
+    rb_define_method(oj_lazy_hash_class, "to_hash", lazy_materialize, 0);
+    rb_define_method(oj_lazy_hash_class, "==", lazy_eql, 1);
+    rb_define_method(oj_lazy_hash_class, "inspect", lazy_inspect, 0);
+
+    oj_lazy_array_class = rb_define_class_under(Oj, "LazyArray", rb_cObject);
+    rb_undef_alloc_func(oj_lazy_array_class);
+    rb_include_module(oj_lazy_array_class, rb_mEnumerable);
+    rb_define_method(oj_lazy_array_class, "[]", lazy_array_aref, 1);
+    rb_define_method(oj_lazy_array_class, "each", lazy_array_each, 0);
+    rb_define_method(oj_lazy_array_class, "size", lazy_size, 0);
+    rb_define_method(oj_lazy_array_class, "length", lazy_size, 0);
+    rb_define_method(oj_lazy_array_class, "empty?", lazy_empty, 0);
+    rb_define_method(oj_lazy_array_class, "dig", lazy_dig, -1);
+    rb_define_method(oj_lazy_array_class, "to_a", lazy_materialize, 0);
+    rb_define_method(oj_lazy_array_class, "to_ary", lazy_materialize, 0);
+    rb_define_method(oj_lazy_array_class, "==", lazy_eql, 1);
+    rb_define_method(oj_lazy_array_class, "inspect", lazy_inspect, 0);
+}
+
 #if 0
 // hack to keep the doc generator happy
 Oj = rb_define_module("Oj");
@@ -31,6 +31,9 @@
 #include "hash.h"
 #include <stdint.h>
 
+#include "oj.h"
+#include "encode.h"
+
 #define HASH_MASK	0x000003FF
 #define  HASH_SLOT_CNT	1024
 
@@ -48,6 +51,31 @@ struct _Hash {
 struct _Hash	class_hash;
 struct _Hash	intern_hash;
 
+// Hash keys are cached as frozen Strings or as Symbols and short String
+// values as frozen Strings. Each cache is split
+// into sets of KEY_WAYS entries picked by the key hash and the least
+// recently used entry of a set is replaced when a new key does not fit.
+// Long keys are rarely repeated so they are not cached.
+#define KEY_SET_MASK	0x000003FF
+#define KEY_SET_CNT	1024
+#define KEY_WAYS	4
+
+typedef struct _KeyStr {
+    VALUE	str;	// frozen String with the key bytes
+    VALUE	val;	// the String itself or the Symbol
+    uint32_t	hash;
+    uint32_t	used;
+} *KeyStr;
+
+typedef struct _KeyCache {
+    struct _KeyStr	entries[KEY_SET_CNT * KEY_WAYS];
+    uint32_t		tick;
+} *KeyCache;
+
+// index 0 holds key Strings, 1 key Symbols, and 2 value Strings
+static struct _KeyCache	key_caches[3];
+static VALUE		key_cache_obj = Qnil;
+
 // almost the Murmur hash algorithm
 #define M 0x5bd1e995
 #define C1 0xCC9E2D51
@@ -86,10 +114,31 @@ hash_calc(const uint8_t *key, size_t len) {
     return h;
 }
 
+static void
+mark_key_caches(void *ptr) {
+    KeyCache	kc;
+    KeyStr	ks;
+    KeyStr	end;
+
+    for (kc = (KeyCache)ptr; kc < key_caches + 3; kc++) {
+	for (ks = kc->entries, end = ks + KEY_SET_CNT * KEY_WAYS; ks < end; ks++) {
+	    if (0 != ks->str) {
+		rb_gc_mark(ks->str);
+		rb_gc_mark(ks->val);
+	    }
+	}
+    }
+}
+
 void
 oj_hash_init() {
     memset(class_hash.slots, 0, sizeof(class_hash.slots));
     memset(intern_hash.slots, 0, sizeof(intern_hash.slots));
+    memset(key_caches, 0, sizeof(key_caches));
+    if (Qnil == key_cache_obj) {
+	key_cache_obj = Data_Wrap_Struct(0, mark_key_caches, 0, key_caches);
+	rb_gc_register_address(&key_cache_obj);
+    }
 }
 
 // if slotp is 0 then just lookup
@@ -149,6 +198,93 @@ oj_attr_hash_get(const char *key, size_t len, ID **slotp) {
     return (ID)hash_get(&intern_hash, key, len, (VALUE**)slotp, 0);
 }
 
+static VALUE
+key_str(const char *key, size_t len) {
+    return rb_str_freeze(oj_encode(rb_str_new(key, len)));
+}
+
+// Symbols are looked up without creating a String first. A Symbol that does
+// not exist yet is created as a dynamic Symbol so it can still be collected
+// once it is no longer referenced or cached.
+static VALUE
+key_sym(const char *key, size_t len) {
+#if HAS_DYNAMIC_SYMBOLS
+    VALUE	sym = rb_check_symbol_cstr(key, (long)len, oj_utf8_encoding);
+
+    if (Qnil != sym) {
+	return sym;
+    }
+#endif
+    return rb_str_intern(oj_encode(rb_str_new(key, len)));
+}
+
+static VALUE
+key_cache_get(KeyCache kc, const char *key, size_t len, VALUE (*make)(const char *key, size_t len)) {
+    uint32_t	h;
+    KeyStr	set;
+    KeyStr	ks;
+    KeyStr	old;
+    VALUE	val;
+
+    if (CACHE_MAX_LEN < len) {
+	return make(key, len);
+    }
+    h = hash_calc((const uint8_t*)key, len);
+    set = kc->entries + (h & KEY_SET_MASK) * KEY_WAYS;
+    old = set;
+    kc->tick++;
+    for (ks = set; ks < set + KEY_WAYS; ks++) {
+	if (0 == ks->str) {
+	    old = ks;
+	    break;
+	}
+	if (h == ks->hash && len == (size_t)RSTRING_LEN(ks->str) && 0 == memcmp(key, RSTRING_PTR(ks->str), len)) {
+	    ks->used = kc->tick;
+	    return ks->val;
+	}
+	// unsigned difference so the tick wrapping around stays ordered
+	if (kc->tick - old->used < kc->tick - ks->used) {
+	    old = ks;
+	}
+    }
+    val = make(key, len);
+#if HAS_DYNAMIC_SYMBOLS
+    old->str = (T_SYMBOL == rb_type(val)) ? rb_sym2str(val) : val;
+#else
+    old->str = val;
+#endif
+    old->val = val;
+    old->hash = h;
+    old->used = kc->tick;
+
+    return val;
+}
+
+// Returns a frozen, UTF-8 encoded String for the key. Identical keys share
+// the same String while it stays in the cache.
+VALUE
+oj_key_cache_get(const char *key, size_t len) {
+    return key_cache_get(key_caches, key, len, key_str);
+}
+
+// Returns the Symbol for the key.
+VALUE
+oj_sym_cache_get(const char *key, size_t len) {
+#if HAS_DYNAMIC_SYMBOLS
+    return key_cache_get(key_caches + 1, key, len, key_sym);
+#else
+    return key_sym(key, len);
+#endif
+}
+
+// Returns a frozen, UTF-8 encoded String for a String value. Values are
+// kept apart from keys so a document with many distinct values does not
+// push the keys out of the cache.
+VALUE
+oj_str_cache_get(const char *str, size_t len) {
+    return key_cache_get(key_caches + 2, str, len, key_str);
+}
+
 char*
 oj_strndup(const char *s, size_t len) {
     char	*d = ALLOC_N(char, len + 1);
@@ -33,12 +33,18 @@
 
 #include "ruby.h"
 
+// longest key or String value that is cached
+#define CACHE_MAX_LEN	64
+
 typedef struct _Hash	*Hash;
 
 extern void	oj_hash_init();
 
 extern VALUE	oj_class_hash_get(const char *key, size_t len, VALUE **slotp);
 extern ID	oj_attr_hash_get(const char *key, size_t len, ID **slotp);
+extern VALUE	oj_key_cache_get(const char *key, size_t len);
+extern VALUE	oj_sym_cache_get(const char *key, size_t len);
+extern VALUE	oj_str_cache_get(const char *str, size_t len);
 
 extern void	oj_hash_print();
 extern char*	oj_strndup(const char *s, size_t len);
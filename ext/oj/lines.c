@@ -0,0 +1,277 @@
+/* lines.c
+ * Copyright (c) 2013, Peter Ohler
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *  - Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ *  - Neither the name of Peter Ohler nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#if HAS_NOGVL
+#include <pthread.h>
+#endif
+
+#include "oj.h"
+#include "err.h"
+#include "parse.h"
+
+#if HAS_NOGVL
+#include "ruby/thread.h"
+
+// Runs of lines are kept big enough that handing them to a thread is cheap
+// compared to indexing them and small enough that the parser does not wait
+// long for the first one.
+#define RUN_MIN		(64 * 1024)
+#define RUN_MAX		(16 * 1024 * 1024)
+#define RUNS_PER_THREAD	16
+// Number of runs per thread that may be indexed before the parser gets to
+// them. Limits the memory held by finished tapes.
+#define RUN_AHEAD	4
+
+typedef enum {
+    RUN_WAIT	= 0,
+    RUN_READY	= 1,
+    RUN_FAILED	= 2,
+} RunState;
+
+typedef struct _Run {
+    struct _Tape	tape;
+    const char		*start;
+    const char		*end;
+    RunState		state;
+} *Run;
+
+typedef struct _Pool {
+    ParseInfo		pi;
+    Run			runs;
+    int			cnt;
+    int			next;	// next run to be indexed
+    int			done;	// runs parsed so far
+    int			ahead;
+    int			cancel;
+    int			wake;	// set when Ruby interrupts the parser
+    int			threads;
+    pthread_t		*tids;
+    pthread_mutex_t	lock;
+    pthread_cond_t	ready;	// a run has been indexed
+    pthread_cond_t	room;	// a run has been parsed or the pool is stopping
+} *Pool;
+
+// Splits the input into runs of about size bytes that end just after a
+// newline. Returns 0 if a run is too long for a tape.
+static int
+split_runs(Pool p, const char *json, const char *end, size_t size) {
+    const char	*s = json;
+    const char	*e;
+    int		max = 0;
+    Run		r;
+
+    while (s < end) {
+	if ((size_t)(end - s) <= size || 0 == (e = memchr(s + size, '\n', end - s - size))) {
+	    e = end;
+	} else {
+	    e++;
+	}
+	if ((size_t)UINT32_MAX <= (size_t)(e - s)) {
+	    return 0;
+	}
+	if (max <= p->cnt) {
+	    max = (0 == max) ? 16 : max * 2;
+	    REALLOC_N(p->runs, struct _Run, max);
+	}
+	r = p->runs + p->cnt++;
+	r->tape.idx = 0;
+	r->start = s;
+	r->end = e;
+	r->state = RUN_WAIT;
+	s = e;
+    }
+    return 1;
+}
+
+// Worker thread. Indexes runs in order without ever touching Ruby.
+static void*
+index_runs(void *arg) {
+    Pool	p = (Pool)arg;
+    Run		r;
+    int		ok;
+
+    pthread_mutex_lock(&p->lock);
+    while (!p->cancel && p->next < p->cnt) {
+	if (p->done + p->ahead <= p->next) {
+	    pthread_cond_wait(&p->room, &p->lock);
+	    continue;
+	}
+	r = p->runs + p->next++;
+	pthread_mutex_unlock(&p->lock);
+	ok = oj_tape_index(&r->tape, r->start, r->end - r->start);
+	pthread_mutex_lock(&p->lock);
+	r->state = ok ? RUN_READY : RUN_FAILED;
+	pthread_cond_broadcast(&p->ready);
+    }
+    pthread_mutex_unlock(&p->lock);
+
+    return 0;
+}
+
+// Called without the GVL to wait for the next run to be indexed.
+static void*
+wait_run(void *arg) {
+    Pool	p = (Pool)arg;
+    Run		r = p->runs + p->done;
+
+    pthread_mutex_lock(&p->lock);
+    while (RUN_WAIT == r->state && !p->wake) {
+	pthread_cond_wait(&p->ready, &p->lock);
+    }
+    p->wake = 0;
+    pthread_mutex_unlock(&p->lock);
+
+    return 0;
+}
+
+static void
+wake_parser(void *arg) {
+    Pool	p = (Pool)arg;
+
+    pthread_mutex_lock(&p->lock);
+    p->wake = 1;
+    pthread_cond_broadcast(&p->ready);
+    pthread_mutex_unlock(&p->lock);
+}
+
+static VALUE
+parse_runs(VALUE pv) {
+    Pool	p = (Pool)pv;
+    ParseInfo	pi = p->pi;
+    Run		r;
+    RunState	state;
+
+    while (p->done < p->cnt) {
+	r = p->runs + p->done;
+	pthread_mutex_lock(&p->lock);
+	state = r->state;
+	pthread_mutex_unlock(&p->lock);
+	if (RUN_WAIT == state) {
+	    rb_thread_call_without_gvl(wait_run, p, wake_parser, p);
+	    rb_thread_check_ints();
+	    continue;
+	}
+	if (RUN_FAILED == state) {
+	    rb_raise(rb_eNoMemError, "failed to allocate a tape for the input");
+	}
+	pi->end = r->end;
+	oj_parse_tape_walk(pi, &r->tape);
+	free(r->tape.idx);
+	r->tape.idx = 0;
+	pthread_mutex_lock(&p->lock);
+	p->done++;
+	pthread_cond_broadcast(&p->room);
+	pthread_mutex_unlock(&p->lock);
+	if (err_has(&pi->err)) {
+	    break;
+	}
+    }
+    return Qnil;
+}
+
+static VALUE
+stop_pool(VALUE pv) {
+    Pool	p = (Pool)pv;
+    int		i;
+
+    pthread_mutex_lock(&p->lock);
+    p->cancel = 1;
+    pthread_cond_broadcast(&p->room);
+    pthread_mutex_unlock(&p->lock);
+    for (i = 0; i < p->threads; i++) {
+	pthread_join(p->tids[i], 0);
+    }
+    for (i = 0; i < p->cnt; i++) {
+	if (0 != p->runs[i].tape.idx) {
+	    free(p->runs[i].tape.idx);
+	}
+    }
+    xfree(p->runs);
+    xfree(p->tids);
+    pthread_cond_destroy(&p->room);
+    pthread_cond_destroy(&p->ready);
+    pthread_mutex_destroy(&p->lock);
+
+    return Qnil;
+}
+#endif
+
+/* Parses newline delimited documents with pi->threads native threads
+ * building the tapes. The input is split into runs of whole lines and the
+ * runs are walked in order on the calling thread so the documents are
+ * created and yielded just as oj_parse_tape() would. The stack carries from
+ * one run to the next so a document may span lines as long as no string or
+ * comment does.
+ */
+void
+oj_parse_lines(ParseInfo pi) {
+#if HAS_NOGVL
+    struct _Pool	pool;
+    size_t		size = (pi->end - pi->json) / ((size_t)pi->threads * RUNS_PER_THREAD);
+    int			i;
+
+    if (RUN_MIN > size) {
+	size = RUN_MIN;
+    } else if (RUN_MAX < size) {
+	size = RUN_MAX;
+    }
+    memset(&pool, 0, sizeof(pool));
+    pool.pi = pi;
+    if (!split_runs(&pool, pi->json, pi->end, size) || 2 > pool.cnt) {
+	xfree(pool.runs);
+	oj_parse_tape(pi);
+	return;
+    }
+    pi->more = 0;
+    err_init(&pi->err);
+    stack_init(&pi->stack);
+    pool.ahead = pi->threads * RUN_AHEAD;
+    pool.tids = ALLOC_N(pthread_t, pi->threads);
+    pthread_mutex_init(&pool.lock, 0);
+    pthread_cond_init(&pool.ready, 0);
+    pthread_cond_init(&pool.room, 0);
+    for (i = 0; i < pi->threads && i < pool.cnt; i++) {
+	if (0 != pthread_create(pool.tids + i, 0, index_runs, &pool)) {
+	    break;
+	}
+	pool.threads++;
+    }
+    if (0 == pool.threads) {
+	stop_pool((VALUE)&pool);
+	oj_parse_tape(pi);
+	return;
+    }
+    rb_ensure(parse_runs, (VALUE)&pool, stop_pool, (VALUE)&pool);
+#else
+    oj_parse_tape(pi);
+#endif
+}
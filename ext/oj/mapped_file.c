@@ -0,0 +1,210 @@
+/* mapped_file.c
+ * Copyright (c) 2012, Peter Ohler
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *  - Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ *  - Neither the name of Peter Ohler nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#if !IS_WINDOWS
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "oj.h"
+#include "mapped_file.h"
+#if HAS_NOGVL
+#include "ruby/thread.h"
+#endif
+
+// First buffer size for input that can not be sized up front.
+#define READ_CHUNK	16384
+
+#if !IS_WINDOWS
+// Maps the file at fd. The parsers stop at a '\0' so the content must end
+// before the last page does, leaving zeros after it. Returns 0 if the file
+// can not be mapped that way.
+static int
+map_file(MappedFile mf, int fd, size_t len, int writable) {
+    size_t	page = (size_t)sysconf(_SC_PAGESIZE);
+    void	*addr;
+
+    if (0 == len || 0 == len % page) {
+	return 0;
+    }
+    // A private mapping is only copied a page at a time as it is written.
+    addr = mmap(0, len, writable ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_PRIVATE, fd, 0);
+    if (MAP_FAILED == addr) {
+	return 0;
+    }
+#ifdef MADV_SEQUENTIAL
+    madvise(addr, len, MADV_SEQUENTIAL);
+#endif
+    mf->json = (char*)addr;
+    mf->len = len;
+    mf->map_len = len;
+
+    return 1;
+}
+#endif
+
+/* Loads the file at path into mf. When map is set a regular file is mapped
+ * instead of copied into the heap. Set writable if the parser writes into
+ * the content. Raises an IOError if the file can not be opened.
+ */
+void
+oj_file_open(MappedFile mf, const char *path, int map, int writable) {
+    FILE	*f;
+    size_t	len;
+
+    mf->json = 0;
+    mf->len = 0;
+    mf->map_len = 0;
+#if !IS_WINDOWS
+    if (map) {
+	struct stat	st;
+	int		fd;
+
+	if (0 > (fd = open(path, O_RDONLY))) {
+	    rb_raise(rb_eIOError, "%s", strerror(errno));
+	}
+	if (0 == fstat(fd, &st) && S_ISREG(st.st_mode) && map_file(mf, fd, (size_t)st.st_size, writable)) {
+	    close(fd);
+	    return;
+	}
+	close(fd);
+    }
+#endif
+    if (0 == (f = fopen(path, "r"))) {
+	rb_raise(rb_eIOError, "%s", strerror(errno));
+    }
+    fseek(f, 0, SEEK_END);
+    len = ftell(f);
+    mf->json = ALLOC_N(char, len + 1);
+    fseek(f, 0, SEEK_SET);
+    if (len != fread(mf->json, 1, len, f)) {
+	xfree(mf->json);
+	mf->json = 0;
+	fclose(f);
+	rb_raise(rb_const_get_at(Oj, rb_intern("LoadError")), "Failed to read %lu bytes from %s.", (unsigned long)len, path);
+    }
+    fclose(f);
+    mf->json[len] = '\0';
+    mf->len = len;
+}
+
+void
+oj_file_close(MappedFile mf) {
+    if (0 == mf->json) {
+	return;
+    }
+#if !IS_WINDOWS
+    if (0 != mf->map_len) {
+	munmap(mf->json, mf->map_len);
+	mf->json = 0;
+	return;
+    }
+#endif
+    xfree(mf->json);
+    mf->json = 0;
+}
+
+#if !IS_WINDOWS
+typedef struct _FdRead {
+    int		fd;
+    char	*buf;
+    size_t	len;
+    ssize_t	cnt;
+    int		err;
+} *FdRead;
+
+static void*
+read_chunk(void *arg) {
+    FdRead	r = (FdRead)arg;
+
+    r->cnt = read(r->fd, r->buf, r->len);
+    r->err = errno;
+
+    return 0;
+}
+
+/* Reads what is left on fd into a String. A regular file is read from the
+ * start in one buffer sized to fit. Pipes, sockets, and terminals can not be
+ * sized so they are read in chunks into a buffer that doubles as it fills.
+ * The GVL is released while blocked in read() so other threads run while
+ * the writer catches up.
+ */
+VALUE
+oj_read_fd(int fd) {
+    struct _FdRead	r;
+    struct stat		st;
+    VALUE		s;
+    size_t		size = READ_CHUNK;
+    size_t		len = 0;
+    size_t		expect = 0;
+
+    if (0 == fstat(fd, &st) && S_ISREG(st.st_mode) && 0 == lseek(fd, 0, SEEK_SET)) {
+	expect = (size_t)st.st_size;
+	size = expect + 1;
+    }
+    s = rb_str_new(0, size);
+    r.fd = fd;
+    while (0 == expect || len < expect) {
+	if (size <= len + 1) {
+	    size *= 2;
+	    rb_str_resize(s, size);
+	}
+	r.buf = RSTRING_PTR(s) + len;
+	r.len = size - len - 1;
+#if HAS_NOGVL
+	rb_thread_call_without_gvl(read_chunk, &r, RUBY_UBF_IO, 0);
+#else
+	rb_thread_wait_fd(fd);
+	read_chunk(&r);
+#endif
+	if (0 < r.cnt) {
+	    len += r.cnt;
+	} else if (0 == r.cnt) {
+	    break;
+	} else if (EINTR == r.err) {
+	    rb_thread_check_ints();
+	} else if (EAGAIN == r.err || EWOULDBLOCK == r.err) {
+	    rb_thread_wait_fd(fd);
+	} else {
+	    rb_raise(rb_eIOError, "failed to read from IO Object. %s", strerror(r.err));
+	}
+    }
+    rb_str_resize(s, len);
+
+    return s;
+}
+#endif
@@ -0,0 +1,117 @@
+/* num.h
+ * Copyright (c) 2013, Peter Ohler
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *  - Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ *  - Neither the name of Peter Ohler nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __OJ_NUM_H__
+#define __OJ_NUM_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "ruby.h"
+
+// Eight digits are converted at once with SWAR arithmetic when the byte
+// order puts the first character in the low byte.
+#if defined(__BYTE_ORDER__) && defined(__ORDER_LITTLE_ENDIAN__) && __ORDER_LITTLE_ENDIAN__ == __BYTE_ORDER__
+#define OJ_SWAR 1
+#endif
+
+typedef struct _NumInfo {
+    int64_t	i;
+    int64_t	num;
+    int64_t	div;
+    const char	*str;
+    size_t	len;
+    long	exp;
+    int		dec_cnt;
+    int		big;
+    int		infinity;
+    int		neg;
+} *NumInfo;
+
+// Reads the number at s, stopping at end, into ni. The sign, digits,
+// fraction, and exponent are checked against the limits that decide between
+// an Integer, a Float, and a BigDecimal. Returns the position after the
+// number. If an 'I' follows the sign infinity is set and the position of the
+// 'I' is returned for the caller to check.
+extern const char*	oj_num_read(NumInfo ni, const char *s, const char *end);
+
+// Returns the Integer, Float, or BigDecimal for a number read by
+// oj_num_read().
+extern VALUE	oj_num_as_value(NumInfo ni);
+
+// Converts a decimal number that has been split into an integer part i, a
+// fraction num/div where div is a power of 10, and a base 10 exponent into
+// the nearest double. The result is correctly rounded. The common cases are
+// handled with the Clinger fast path or the Eisel-Lemire algorithm. The rare
+// cases those can not decide are handed to the Ruby string to double
+// conversion using the original text in str, which includes the sign.
+extern double	oj_num_to_double(int neg, uint64_t i, uint64_t num, uint64_t div, long exp, const char *str, size_t len);
+
+// Writes the shortest decimal form of d that reads back as the same double
+// and returns its length. The layout follows what "%.1f" and "%g" produce
+// so integers end with ".0" and very large or small values use an exponent.
+// The buffer must hold at least 32 characters. d must not be 0.0, infinite,
+// or NaN. No terminator is written.
+extern int	oj_dtoa(double d, char *buf);
+
+#ifdef OJ_SWAR
+// Loads the 8 characters at s into v if they are all before end.
+inline static int
+oj_num_load8(const char *s, const char *end, uint64_t *v) {
+    if (end - s < 8) {
+	return 0;
+    }
+    memcpy(v, s, sizeof(*v));
+
+    return 1;
+}
+
+// Returns non-zero if all 8 characters are '0' through '9'.
+inline static int
+oj_num_is8(uint64_t v) {
+    return 0x3333333333333333ULL == ((v & 0xF0F0F0F0F0F0F0F0ULL) |
+				     (((v + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4));
+}
+
+// Converts 8 digit characters to their value. The pairs, then the quads, are
+// combined with a multiply each.
+inline static uint32_t
+oj_num_parse8(uint64_t v) {
+    v -= 0x3030303030303030ULL;
+    v = v * 10 + (v >> 8);
+    v = (((v & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32))) +
+	 (((v >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32)))) >> 32;
+
+    return (uint32_t)v;
+}
+#endif
+
+#endif /* __OJ_NUM_H__ */
@@ -57,15 +57,12 @@ hash_key(ParseInfo pi, const char *key, size_t klen, char k1) {
     VALUE	rkey;
 
     if (':' == k1) {
-	rkey = rb_str_new(key + 1, klen - 1);
-	rkey = oj_encode(rkey);
-	rkey = rb_funcall(rkey, oj_to_sym_id, 0);
+	rkey = oj_sym_cache_get(key + 1, klen - 1);
+    } else if (Yes == pi->options.sym_key) {
+	rkey = oj_sym_cache_get(key, klen);
     } else {
 	rkey = rb_str_new(key, klen);
 	rkey = oj_encode(rkey);
-	if (Yes == pi->options.sym_key) {
-	    rkey = rb_str_intern(rkey);
-	}
     }
     return rkey;
 }
@@ -75,9 +72,7 @@ str_to_value(ParseInfo pi, const char *str, size_t len, const char *orig) {
     VALUE	rstr = Qnil;
 
     if (':' == *orig && 0 < len) {
-	rstr = rb_str_new(str + 1, len - 1);
-	rstr = oj_encode(rstr);
-	rstr = rb_funcall(rstr, oj_to_sym_id, 0);
+	rstr = oj_sym_cache_get(str + 1, len - 1);
     } else if (pi->circ_array && 3 <= len && '^' == *orig && 'r' == orig[1]) {
 	long	i = read_long(str + 2, len - 2);
 
@@ -114,13 +109,11 @@ hat_cstr(ParseInfo pi, Val parent, const char *key, size_t klen, const char *str
 		    return 0;
 		}
 		parent->val = odd->clas;
-		parent->odd_args = oj_odd_alloc_args(odd);
+		parent->odd_args = oj_odd_alloc_args(odd, &pi->arena);
 	    }
 	    break;
 	case 'm':
-	    parent->val = rb_str_new(str + 1, len - 1);
-	    parent->val = oj_encode(parent->val);
-	    parent->val = rb_funcall(parent->val, oj_to_sym_id, 0);
+	    parent->val = oj_sym_cache_get(str + 1, len - 1);
 	    break;
 	case 's':
 	    parent->val = rb_str_new(str, len);
@@ -453,11 +446,31 @@ end_hash(struct _ParseInfo *pi) {
 	OddArgs	oa = parent->odd_args;
 
 	parent->val = rb_funcall2(oa->odd->create_obj, oa->odd->create_op, oa->odd->attr_cnt, oa->args);
-	oj_odd_free(oa);
 	parent->odd_args = 0;
     }
 }
 
+// Arrays are created when they open rather than built from the value stack
+// when they close so that a circular reference id can be set on them.
+static VALUE
+start_array(ParseInfo pi) {
+    return rb_ary_new();
+}
+
+static void
+end_array(ParseInfo pi) {
+}
+
+static void
+array_append_num(ParseInfo pi, NumInfo ni) {
+    rb_ary_push(stack_peek(&pi->stack)->val, oj_num_as_value(ni));
+}
+
+static void
+array_append_value(ParseInfo pi, VALUE value) {
+    rb_ary_push(stack_peek(&pi->stack)->val, value);
+}
+
 static void
 array_append_cstr(ParseInfo pi, const char *str, size_t len, const char *orig) {
     if (3 <= len && 0 != pi->circ_array) {
@@ -498,13 +511,17 @@ oj_object_parse(int argc, VALUE *argv, VALUE self) {
     pi.hash_set_num = hash_set_num;
     pi.hash_set_value = hash_set_value;
     pi.add_cstr = add_cstr;
+    pi.start_array = start_array;
+    pi.end_array = end_array;
     pi.array_append_cstr = array_append_cstr;
+    pi.array_append_num = array_append_num;
+    pi.array_append_value = array_append_value;
 
-    return oj_pi_parse(argc, argv, &pi, 0);
+    return oj_pi_parse(argc, argv, &pi, 0, 0);
 }
 
 VALUE
-oj_object_parse_cstr(int argc, VALUE *argv, char *json) {
+oj_object_parse_cstr(int argc, VALUE *argv, char *json, size_t len) {
     struct _ParseInfo	pi;
 
     pi.options = oj_default_options;
@@ -515,7 +532,11 @@ oj_object_parse_cstr(int argc, VALUE *argv, char *json) {
     pi.hash_set_num = hash_set_num;
     pi.hash_set_value = hash_set_value;
     pi.add_cstr = add_cstr;
+    pi.start_array = start_array;
+    pi.end_array = end_array;
     pi.array_append_cstr = array_append_cstr;
+    pi.array_append_num = array_append_num;
+    pi.array_append_value = array_append_value;
 
-    return oj_pi_parse(argc, argv, &pi, json);
+    return oj_pi_parse(argc, argv, &pi, json, len);
 }
@@ -126,8 +126,8 @@ oj_get_oddc(const char *classname, size_t len) {
 }
 
 OddArgs
-oj_odd_alloc_args(Odd odd) {
-    OddArgs	oa = ALLOC_N(struct _OddArgs, 1);
+oj_odd_alloc_args(Odd odd, Arena arena) {
+    OddArgs	oa = (OddArgs)arena_alloc(arena, sizeof(struct _OddArgs));
     VALUE	*a;
     int		i;
 
@@ -138,11 +138,6 @@ oj_odd_alloc_args(Odd odd) {
     return oa;
 }
 
-void
-oj_odd_free(OddArgs args) {
-    xfree(args);
-}
-
 int
 oj_odd_set_arg(OddArgs args, const char *key, size_t klen, VALUE value) {
     const char	**np;
@@ -32,6 +32,7 @@
 #define __OJ_ODD_H__
 
 #include "ruby.h"
+#include "arena.h"
 
 #define MAX_ODD_ARGS	10
 
@@ -54,8 +55,7 @@ typedef struct _OddArgs {
 extern void	oj_odd_init(void);
 extern Odd	oj_get_odd(VALUE clas);
 extern Odd	oj_get_oddc(const char *classname, size_t len);
-extern OddArgs	oj_odd_alloc_args(Odd odd);
-extern void	oj_odd_free(OddArgs args);
+extern OddArgs	oj_odd_alloc_args(Odd odd, Arena arena);
 extern int	oj_odd_set_arg(OddArgs args, const char *key, size_t klen, VALUE value);
 
 #endif /* __OJ_ODD_H__ */
@@ -41,6 +41,8 @@
 #include "hash.h"
 #include "odd.h"
 #include "encode.h"
+#include "simd.h"
+#include "mapped_file.h"
 
 typedef struct _YesNoOpt {
     VALUE	sym;
@@ -82,12 +84,14 @@ VALUE	oj_bag_class;
 VALUE	oj_bigdecimal_class;
 VALUE	oj_date_class;
 VALUE	oj_datetime_class;
+VALUE	oj_options_class;
 VALUE	oj_parse_error_class;
 VALUE	oj_stringio_class;
 VALUE	oj_struct_class;
 VALUE	oj_time_class;
 
 VALUE	oj_slash_string;
+VALUE	oj_skip_obj;
 
 static VALUE	ascii_only_sym;
 static VALUE	auto_define_sym;
@@ -95,16 +99,26 @@ static VALUE	bigdecimal_as_decimal_sym;
 static VALUE	bigdecimal_load_sym;
 static VALUE	circular_sym;
 static VALUE	class_cache_sym;
+static VALUE	cache_keys_sym;
+static VALUE	cache_str_sym;
 static VALUE	compat_sym;
 static VALUE	create_id_sym;
 static VALUE	indent_sym;
+static VALUE	mmap_sym;
 static VALUE	mode_sym;
+static VALUE	length_sym;
 static VALUE	null_sym;
 static VALUE	object_sym;
+static VALUE	offset_sym;
 static VALUE	ruby_sym;
 static VALUE	sec_prec_sym;
+static VALUE	float_prec_sym;
 static VALUE	strict_sym;
 static VALUE	symbol_keys_sym;
+static VALUE	threads_sym;
+static VALUE	lazy_sym;
+static VALUE	only_sym;
+static VALUE	tape_sym;
 static VALUE	time_format_sym;
 static VALUE	unix_sym;
 static VALUE	xmlschema_sym;
@@ -140,9 +154,13 @@ struct _Options	oj_default_options = {
     UnixTime,		// time_format
     Yes,		// bigdec_as_num
     No,			// bigdec_load
+    No,			// tape
+    Yes,		// cache_keys
+    0,			// cache_str
     json_class,		// create_id
     10,			// create_id_len
     9,			// sec_prec
+    0,			// float_prec
     0,			// dump_opts
 };
 
@@ -160,8 +178,12 @@ static VALUE	define_mimic_json(int argc, VALUE *argv, VALUE self);
  * - time_format: [:unix|:xmlschema|:ruby] time format when dumping in :compat mode
  * - bigdecimal_as_decimal: [true|false|nil] dump BigDecimal as a decimal number or as a String
  * - bigdecimal_load: [true|false|nil] load decimals as BigDecimal instead of as a Float
+ * - tape: [true|false|nil] index the document before parsing instead of parsing a byte at a time
+ * - cache_keys: [true|false|nil] share frozen String hash keys between documents in :strict and :compat mode
+ * - cache_str: [Fixnum] share frozen String values up to this many bytes in :strict and :compat mode, 0 to not share
  * - create_id: [String|nil] create id for json compatible object encoding, default is 'json_create'
  * - second_precision: [Fixnum|nil] number of digits after the decimal when dumping the seconds portion of time
+ * - float_precision: [Fixnum] significant digits when dumping a Float, 0 for the shortest form that loads back the same
  * @return [Hash] all current option settings.
  */
 static VALUE
@@ -170,6 +192,8 @@ get_def_opts(VALUE self) {
     
     rb_hash_aset(opts, indent_sym, INT2FIX(oj_default_options.indent));
     rb_hash_aset(opts, sec_prec_sym, INT2FIX(oj_default_options.sec_prec));
+    rb_hash_aset(opts, float_prec_sym, INT2FIX(oj_default_options.float_prec));
+    rb_hash_aset(opts, cache_str_sym, INT2FIX(oj_default_options.cache_str));
     rb_hash_aset(opts, circular_sym, (Yes == oj_default_options.circular) ? Qtrue : ((No == oj_default_options.circular) ? Qfalse : Qnil));
     rb_hash_aset(opts, class_cache_sym, (Yes == oj_default_options.class_cache) ? Qtrue : ((No == oj_default_options.class_cache) ? Qfalse : Qnil));
     rb_hash_aset(opts, auto_define_sym, (Yes == oj_default_options.auto_define) ? Qtrue : ((No == oj_default_options.auto_define) ? Qfalse : Qnil));
@@ -177,6 +201,8 @@ get_def_opts(VALUE self) {
     rb_hash_aset(opts, symbol_keys_sym, (Yes == oj_default_options.sym_key) ? Qtrue : ((No == oj_default_options.sym_key) ? Qfalse : Qnil));
     rb_hash_aset(opts, bigdecimal_as_decimal_sym, (Yes == oj_default_options.bigdec_as_num) ? Qtrue : ((No == oj_default_options.bigdec_as_num) ? Qfalse : Qnil));
     rb_hash_aset(opts, bigdecimal_load_sym, (Yes == oj_default_options.bigdec_load) ? Qtrue : ((No == oj_default_options.bigdec_load) ? Qfalse : Qnil));
+    rb_hash_aset(opts, tape_sym, (Yes == oj_default_options.tape) ? Qtrue : ((No == oj_default_options.tape) ? Qfalse : Qnil));
+    rb_hash_aset(opts, cache_keys_sym, (Yes == oj_default_options.cache_keys) ? Qtrue : ((No == oj_default_options.cache_keys) ? Qfalse : Qnil));
     switch (oj_default_options.mode) {
     case StrictMode:	rb_hash_aset(opts, mode_sym, strict_sym);	break;
     case CompatMode:	rb_hash_aset(opts, mode_sym, compat_sym);	break;
@@ -207,6 +233,12 @@ get_def_opts(VALUE self) {
  * @param [true|false|nil] :ascii_only encode all high-bit characters as escaped sequences if true
  * @param [true|false|nil] :bigdecimal_as_decimal dump BigDecimal as a decimal number or as a String
  * @param [true|false|nil] :bigdecimal_load load decimals as a BigDecimal instead of as a Float
+ * @param [true|false|nil] :tape build a structural index of the document
+ *	  first and then walk it instead of parsing a byte at a time
+ * @param [true|false|nil] :cache_keys reuse frozen String hash keys from a
+ *	  bounded cache instead of creating a new String for every key
+ * @param [Fixnum] :cache_str reuse frozen Strings for String values up to
+ *	  this many bytes, at most 64, with 0 turning it off
  * @param [:object|:strict|:compat|:null] load and dump mode to use for JSON
  *	  :strict raises an exception when a non-supported Object is
  *	  encountered. :compat attempts to extract variable values from an
@@ -221,6 +253,9 @@ get_def_opts(VALUE self) {
  *        :ruby Time.to_s formatted String
  * @param [String|nil] :create_id create id for json compatible object encoding
  * @param [Fixnum|nil] :second_precision number of digits after the decimal when dumping the seconds portion of time
+ * @param [Fixnum] :float_precision significant digits when dumping a Float,
+ *	  at most 20. The default of 0 writes the shortest form that loads
+ *	  back as the same Float. 15 matches the output of earlier versions.
  * @return [nil]
  */
 static VALUE
@@ -233,6 +268,8 @@ set_def_opts(VALUE self, VALUE opts) {
 	{ ascii_only_sym, &oj_default_options.ascii_only },
 	{ bigdecimal_as_decimal_sym, &oj_default_options.bigdec_as_num },
 	{ bigdecimal_load_sym, &oj_default_options.bigdec_load },
+	{ tape_sym, &oj_default_options.tape },
+	{ cache_keys_sym, &oj_default_options.cache_keys },
 	{ Qnil, 0 }
     };
     YesNoOpt	o;
@@ -257,6 +294,32 @@ set_def_opts(VALUE self, VALUE opts) {
 	}
 	oj_default_options.sec_prec = n;
     }
+    v = rb_hash_aref(opts, float_prec_sym);
+    if (Qnil != v) {
+	int	n;
+
+	Check_Type(v, T_FIXNUM);
+	n = FIX2INT(v);
+	if (0 > n) {
+	    n = 0;
+	} else if (20 < n) {
+	    n = 20;
+	}
+	oj_default_options.float_prec = n;
+    }
+    v = rb_hash_aref(opts, cache_str_sym);
+    if (Qnil != v) {
+	int	n;
+
+	Check_Type(v, T_FIXNUM);
+	n = FIX2INT(v);
+	if (0 > n) {
+	    n = 0;
+	} else if (CACHE_MAX_LEN < n) {
+	    n = CACHE_MAX_LEN;
+	}
+	oj_default_options.cache_str = n;
+    }
 
     v = rb_hash_lookup(opts, mode_sym);
     if (Qnil == v) {
@@ -321,6 +384,16 @@ set_def_opts(VALUE self, VALUE opts) {
     return Qnil;
 }
 
+// Options compiled once by Oj::Options.new() so they can be used over and
+// over without looking each one up in a Hash.
+typedef struct _CompiledOpts {
+    struct _Options	opts;
+    int			threads;
+    int			map;
+    int			lazy;
+    VALUE		only;	// frozen copy of the :only paths or nil
+} *CompiledOpts;
+
 void
 oj_parse_options(VALUE ropts, Options copts) {
     struct _YesNoOpt	ynos[] = {
@@ -331,11 +404,15 @@ oj_parse_options(VALUE ropts, Options copts) {
 	{ ascii_only_sym, &copts->ascii_only },
 	{ bigdecimal_as_decimal_sym, &copts->bigdec_as_num },
 	{ bigdecimal_load_sym, &copts->bigdec_load },
+	{ tape_sym, &copts->tape },
+	{ cache_keys_sym, &copts->cache_keys },
 	{ Qnil, 0 }
     };
     YesNoOpt	o;
     
-    if (rb_cHash == rb_obj_class(ropts)) {
+    if (oj_options_class == rb_obj_class(ropts)) {
+	*copts = ((CompiledOpts)DATA_PTR(ropts))->opts;
+    } else if (rb_cHash == rb_obj_class(ropts)) {
 	VALUE	v;
 	
 	if (Qnil != (v = rb_hash_lookup(ropts, indent_sym))) {
@@ -358,6 +435,34 @@ oj_parse_options(VALUE ropts, Options copts) {
 	    }
 	    copts->sec_prec = n;
 	}
+	if (Qnil != (v = rb_hash_lookup(ropts, float_prec_sym))) {
+	    int	n;
+
+	    if (rb_cFixnum != rb_obj_class(v)) {
+		rb_raise(rb_eArgError, ":float_precision must be a Fixnum.");
+	    }
+	    n = NUM2INT(v);
+	    if (0 > n) {
+		n = 0;
+	    } else if (20 < n) {
+		n = 20;
+	    }
+	    copts->float_prec = n;
+	}
+	if (Qnil != (v = rb_hash_lookup(ropts, cache_str_sym))) {
+	    int	n;
+
+	    if (rb_cFixnum != rb_obj_class(v)) {
+		rb_raise(rb_eArgError, ":cache_str must be a Fixnum.");
+	    }
+	    n = NUM2INT(v);
+	    if (0 > n) {
+		n = 0;
+	    } else if (CACHE_MAX_LEN < n) {
+		n = CACHE_MAX_LEN;
+	    }
+	    copts->cache_str = n;
+	}
 	if (Qnil != (v = rb_hash_lookup(ropts, mode_sym))) {
 	    if (object_sym == v) {
 		copts->mode = ObjectMode;
@@ -385,8 +490,9 @@ oj_parse_options(VALUE ropts, Options copts) {
 	if (Qtrue == rb_funcall(ropts, rb_intern("has_key?"), 1, create_id_sym)) {
 	    v = rb_hash_lookup(ropts, create_id_sym);
 	    if (Qnil == v) {
-		if (json_class != oj_default_options.create_id) {
-		    xfree((char*)oj_default_options.create_id);
+		if (0 != copts->create_id && oj_default_options.create_id != copts->create_id &&
+		    json_class != copts->create_id) {
+		    xfree((char*)copts->create_id);
 		}
 		copts->create_id = 0;
 		copts->create_id_len = 0;
@@ -396,6 +502,10 @@ oj_parse_options(VALUE ropts, Options copts) {
 
 		if (len != copts->create_id_len ||
 		    0 != strcmp(copts->create_id, str)) {
+		    if (0 != copts->create_id && oj_default_options.create_id != copts->create_id &&
+			json_class != copts->create_id) {
+			xfree((char*)copts->create_id);
+		    }
 		    copts->create_id = ALLOC_N(char, len + 1);
 		    strcpy((char*)copts->create_id, str);
 		    copts->create_id_len = len;
@@ -494,9 +604,63 @@ oj_parse_options(VALUE ropts, Options copts) {
  * specified are not valid. If the string input is not a valid JSON document (an
  * empty string is not a valid JSON document) an exception is raised.
  *
+ * When json is a String the :offset and :length options select the part of
+ * it to parse. The slice is parsed in place without a copy.
+ *
+ * If a block is given the input may hold any number of JSON documents, one
+ * after another or one per line. Each is yielded as soon as it is complete
+ * and nil is returned.
+ *
+ * With the :lazy option and no block the document is indexed but not
+ * converted. JSON objects and arrays are returned as read only Oj::LazyHash
+ * and Oj::LazyArray proxies and values are only created for what is read
+ * from them, the same way Oj::Doc creates them. The :symbol_keys and
+ * :cache_keys options apply to the keys they return.
+ *
+ * The :only option takes an Array of paths, in the form Oj::Doc#fetch uses,
+ * and the result holds just the values on those paths. A '*' step matches
+ * any key or Array element so a path can pick the same field out of every
+ * element of an Array. Everything off the paths is skipped by
+ * matching brackets and quotes without being checked or converted. Array
+ * indexes start at 1 and up to 64 paths can be given.
+ *
  * @param [String|IO] json JSON String or an Object that responds to read()
  * @param [Hash] options load options (same as default_options)
+ * @yield [doc] each document in the input when a block is given
  */
+// Returns the :mode in ropts or mode if it is not set.
+static Mode
+opts_mode(VALUE ropts, Mode mode) {
+    VALUE	v;
+
+    if (oj_options_class == rb_obj_class(ropts)) {
+	return (Mode)((CompiledOpts)DATA_PTR(ropts))->opts.mode;
+    }
+    if (Qnil != (v = rb_hash_lookup(ropts, mode_sym))) {
+	if (object_sym == v) {
+	    mode = ObjectMode;
+	} else if (strict_sym == v) {
+	    mode = StrictMode;
+	} else if (compat_sym == v) {
+	    mode = CompatMode;
+	} else if (null_sym == v) {
+	    mode = NullMode;
+	} else {
+	    rb_raise(rb_eArgError, ":mode must be :object, :strict, :compat, or :null.");
+	}
+    }
+    return mode;
+}
+
+// Returns true if the :lazy option in ropts is set.
+static int
+opts_lazy(VALUE ropts) {
+    if (oj_options_class == rb_obj_class(ropts)) {
+	return ((CompiledOpts)DATA_PTR(ropts))->lazy;
+    }
+    return (rb_cHash == rb_obj_class(ropts) && RTEST(rb_hash_lookup(ropts, lazy_sym)));
+}
+
 static VALUE
 load(int argc, VALUE *argv, VALUE self) {
     Mode	mode = oj_default_options.mode;
@@ -505,22 +669,10 @@ load(int argc, VALUE *argv, VALUE self) {
 	rb_raise(rb_eArgError, "Wrong number of arguments to load().");
     }
     if (2 <= argc) {
-	VALUE	ropts = argv[1];
-	VALUE	v;
-
-	if (Qnil != (v = rb_hash_lookup(ropts, mode_sym))) {
-	    if (object_sym == v) {
-		mode = ObjectMode;
-	    } else if (strict_sym == v) {
-		mode = StrictMode;
-	    } else if (compat_sym == v) {
-		mode = CompatMode;
-	    } else if (null_sym == v) {
-		mode = NullMode;
-	    } else {
-		rb_raise(rb_eArgError, ":mode must be :object, :strict, :compat, or :null.");
-	    }
+	if (opts_lazy(argv[1]) && !rb_block_given_p()) {
+	    return oj_lazy_load(*argv, argv[1]);
 	}
+	mode = opts_mode(argv[1], mode);
     }
     switch (mode) {
     case StrictMode:
@@ -535,6 +687,184 @@ load(int argc, VALUE *argv, VALUE self) {
     return oj_object_parse(argc, argv, self);
 }
 
+/* call-seq: load_lines(json, options) { |doc| ... } => nil
+ *
+ * Parses newline delimited or concatenated JSON documents and yields each one
+ * to the block as it is completed. The parser is set up once for the whole
+ * input. If no block is given an Enumerator is returned.
+ *
+ * With the :threads option the input is split into runs of whole lines and
+ * that many native threads build the structural index of each run without
+ * holding the GVL. The documents are still created and yielded in order on
+ * the calling thread. Strings and comments must not contain a newline when
+ * :threads is used.
+ *
+ * @param [String|IO] json JSON String or an Object that responds to read()
+ * @param [Hash] options load options (same as default_options) and :threads
+ * @yield [doc] each document in the input
+ */
+static VALUE
+load_lines(int argc, VALUE *argv, VALUE self) {
+    RETURN_ENUMERATOR(self, argc, argv);
+    load(argc, argv, self);
+
+    return Qnil;
+}
+
+// Narrows the String from *startp to *endp to the :offset and :length in
+// ropts.
+void
+oj_parse_slice(VALUE ropts, const char **startp, const char **endp) {
+    VALUE	v;
+    long	len = (long)(*endp - *startp);
+    long	n;
+
+    if (rb_cHash != rb_obj_class(ropts)) {
+	return;
+    }
+    if (Qnil != (v = rb_hash_lookup(ropts, offset_sym))) {
+	n = NUM2LONG(v);
+	if (0 > n || len < n) {
+	    rb_raise(rb_eArgError, ":offset must be within the String.");
+	}
+	*startp += n;
+	len -= n;
+    }
+    if (Qnil != (v = rb_hash_lookup(ropts, length_sym))) {
+	n = NUM2LONG(v);
+	if (0 > n || len < n) {
+	    rb_raise(rb_eArgError, ":length must not extend past the end of the String.");
+	}
+	*endp = *startp + n;
+    }
+}
+
+// Returns the :threads option in ropts or 0 if not set.
+int
+oj_parse_threads(VALUE ropts) {
+    VALUE	v;
+    int		n;
+
+    if (oj_options_class == rb_obj_class(ropts)) {
+	return ((CompiledOpts)DATA_PTR(ropts))->threads;
+    }
+    if (rb_cHash != rb_obj_class(ropts) || Qnil == (v = rb_hash_lookup(ropts, threads_sym))) {
+	return 0;
+    }
+    n = NUM2INT(v);
+    if (0 > n) {
+	rb_raise(rb_eArgError, ":threads must be zero or more.");
+    }
+    return n;
+}
+
+// Returns the :only paths in ropts or nil if not set.
+VALUE
+oj_parse_only(VALUE ropts) {
+    if (oj_options_class == rb_obj_class(ropts)) {
+	return ((CompiledOpts)DATA_PTR(ropts))->only;
+    }
+    if (rb_cHash != rb_obj_class(ropts)) {
+	return Qnil;
+    }
+    return rb_hash_lookup(ropts, only_sym);
+}
+
+static void
+options_mark(void *ptr) {
+    rb_gc_mark(((CompiledOpts)ptr)->only);
+}
+
+static void
+options_free(void *ptr) {
+    CompiledOpts	co = (CompiledOpts)ptr;
+
+    if (0 != co->opts.create_id && json_class != co->opts.create_id) {
+	xfree((char*)co->opts.create_id);
+    }
+    xfree(co);
+}
+
+/* call-seq: new(opts) => Oj::Options
+ *
+ * Validates an options Hash once and compiles it over the current default
+ * options. The frozen result can be passed to load(), load_file(), dump(),
+ * and the other calls that take options in place of the Hash, skipping the
+ * lookups a Hash needs on every call. Later changes to the default options
+ * are not seen by it and the :offset and :length options are not kept.
+ *
+ * @param [Hash] opts options (same as default_options) along with :threads,
+ *	  :mmap, :lazy, and :only
+ */
+static VALUE
+options_new(VALUE clas, VALUE ropts) {
+    CompiledOpts	co;
+    VALUE		self;
+    VALUE		v;
+
+    Check_Type(ropts, T_HASH);
+    co = ALLOC(struct _CompiledOpts);
+    co->opts = oj_default_options;
+    co->threads = 0;
+    co->map = 1;
+    co->lazy = 0;
+    co->only = Qnil;
+    // the default create_id can be freed when the defaults change
+    if (0 != co->opts.create_id && json_class != co->opts.create_id) {
+	co->opts.create_id = oj_strndup(co->opts.create_id, co->opts.create_id_len);
+    }
+    self = Data_Wrap_Struct(clas, options_mark, options_free, co);
+    oj_parse_options(ropts, &co->opts);
+    co->threads = oj_parse_threads(ropts);
+    if (Qfalse == rb_hash_lookup(ropts, mmap_sym)) {
+	co->map = 0;
+    }
+    co->lazy = RTEST(rb_hash_lookup(ropts, lazy_sym));
+    if (Qnil != (v = rb_hash_lookup(ropts, only_sym))) {
+	long	i;
+
+	oj_only_free(oj_only_new(v)); // raises if not valid
+	co->only = rb_ary_new();
+	for (i = 0; i < RARRAY_LEN(v); i++) {
+	    rb_ary_push(co->only, rb_str_new_frozen(rb_ary_entry(v, i)));
+	}
+	rb_obj_freeze(co->only);
+    }
+
+    return rb_obj_freeze(self);
+}
+
+typedef struct _LoadFile {
+    int			argc;
+    VALUE		*argv;
+    Mode		mode;
+    struct _MappedFile	mf;
+} *LoadFile;
+
+static VALUE
+load_file_parse(VALUE lfv) {
+    LoadFile	lf = (LoadFile)lfv;
+
+    switch (lf->mode) {
+    case StrictMode:
+	return oj_strict_parse_cstr(lf->argc, lf->argv, lf->mf.json, lf->mf.len);
+    case NullMode:
+    case CompatMode:
+	return oj_compat_parse_cstr(lf->argc, lf->argv, lf->mf.json, lf->mf.len);
+    case ObjectMode:
+    default:
+	break;
+    }
+    return oj_object_parse_cstr(lf->argc, lf->argv, lf->mf.json, lf->mf.len);
+}
+
+static VALUE
+load_file_close(VALUE lfv) {
+    oj_file_close(&((LoadFile)lfv)->mf);
+
+    return Qnil;
+}
+
 /* Document-method: load_file
  *   call-seq: load_file(path, options) => Object, Hash, Array, String, Fixnum, Float, true, false, or nil
  *
@@ -547,67 +877,41 @@ load(int argc, VALUE *argv, VALUE self) {
  * If the input file is not a valid JSON document (an empty file is not a valid
  * JSON document) an exception is raised.
  *
+ * Regular files are mapped into memory rather than read into a copy. Pass
+ * :mmap => false to read the file instead, for example when it may change
+ * while it is being loaded.
+ *
  * @param [String] path path to a file containing a JSON document
  * @param [Hash] options load options (same as default_options)
  */
 static VALUE
 load_file(int argc, VALUE *argv, VALUE self) {
+    struct _LoadFile	lf;
     char		*path;
-    char		*json;
-    FILE		*f;
-    unsigned long	len;
-    Mode		mode = oj_default_options.mode;
-
-    Check_Type(*argv, T_STRING);
-    path = StringValuePtr(*argv);
-    if (0 == (f = fopen(path, "r"))) {
-	rb_raise(rb_eIOError, "%s", strerror(errno));
-    }
-    fseek(f, 0, SEEK_END);
-    len = ftell(f);
-    json = ALLOC_N(char, len + 1);
-    fseek(f, 0, SEEK_SET);
-    if (len != fread(json, 1, len, f)) {
-	xfree(json);
-	fclose(f);
-	rb_raise(rb_const_get_at(Oj, rb_intern("LoadError")), "Failed to read %ld bytes from %s.", len, path);
-    }
-    fclose(f);
-    json[len] = '\0';
+    int			map = 1;
 
     if (1 > argc) {
 	rb_raise(rb_eArgError, "Wrong number of arguments to load().");
     }
+    Check_Type(*argv, T_STRING);
+    path = StringValuePtr(*argv);
+    lf.argc = argc;
+    lf.argv = argv;
+    lf.mode = oj_default_options.mode;
     if (2 <= argc) {
 	VALUE	ropts = argv[1];
-	VALUE	v;
 
-	if (Qnil != (v = rb_hash_lookup(ropts, mode_sym))) {
-	    if (object_sym == v) {
-		mode = ObjectMode;
-	    } else if (strict_sym == v) {
-		mode = StrictMode;
-	    } else if (compat_sym == v) {
-		mode = CompatMode;
-	    } else if (null_sym == v) {
-		mode = NullMode;
-	    } else {
-		rb_raise(rb_eArgError, ":mode must be :object, :strict, :compat, or :null.");
-	    }
+	lf.mode = opts_mode(ropts, lf.mode);
+	if (oj_options_class == rb_obj_class(ropts)) {
+	    map = ((CompiledOpts)DATA_PTR(ropts))->map;
+	} else if (Qfalse == rb_hash_lookup(ropts, mmap_sym)) {
+	    map = 0;
 	}
     }
-    // The json string is freed in the parser when it is finished with it.
-    switch (mode) {
-    case StrictMode:
-	return oj_strict_parse_cstr(argc, argv, json);
-    case NullMode:
-    case CompatMode:
-	return oj_compat_parse_cstr(argc, argv, json);
-    case ObjectMode:
-    default:
-	break;
-    }
-    return oj_object_parse_cstr(argc, argv, json);
+    // The parsers only read the content so it is mapped rather than copied.
+    oj_file_open(&lf.mf, path, map, 0);
+
+    return rb_ensure(load_file_parse, (VALUE)&lf, load_file_close, (VALUE)&lf);
 }
 
 /* call-seq: safe_load(doc)
@@ -631,7 +935,7 @@ safe_load(VALUE self, VALUE doc) {
     oj_set_strict_callbacks(&pi);
     *args = doc;
 
-    return oj_pi_parse(1, args, &pi, 0);
+    return oj_pi_parse(1, args, &pi, 0, 0);
 }
 
 /* call-seq: saj_parse(handler, io)
@@ -939,7 +1243,7 @@ mimic_parse(int argc, VALUE *argv, VALUE self) {
     }
     *args = *argv;
 
-    return oj_pi_parse(1, args, &pi, 0);
+    return oj_pi_parse(1, args, &pi, 0, 0);
 }
 
 static VALUE
@@ -1110,6 +1414,7 @@ void Init_oj() {
     rb_define_module_function(Oj, "mimic_JSON", define_mimic_json, -1);
     rb_define_module_function(Oj, "load", load, -1);
     rb_define_module_function(Oj, "load_file", load_file, -1);
+    rb_define_module_function(Oj, "load_lines", load_lines, -1);
     rb_define_module_function(Oj, "safe_load", safe_load, 1);
     rb_define_module_function(Oj, "strict_load", oj_strict_parse, -1);
     rb_define_module_function(Oj, "compat_load", oj_compat_parse, -1);
@@ -1161,33 +1466,54 @@ void Init_oj() {
     auto_define_sym = ID2SYM(rb_intern("auto_define"));	rb_gc_register_address(&auto_define_sym);
     bigdecimal_as_decimal_sym = ID2SYM(rb_intern("bigdecimal_as_decimal"));rb_gc_register_address(&bigdecimal_as_decimal_sym);
     bigdecimal_load_sym = ID2SYM(rb_intern("bigdecimal_load"));rb_gc_register_address(&bigdecimal_load_sym);
+    cache_keys_sym = ID2SYM(rb_intern("cache_keys"));	rb_gc_register_address(&cache_keys_sym);
+    cache_str_sym = ID2SYM(rb_intern("cache_str"));	rb_gc_register_address(&cache_str_sym);
     circular_sym = ID2SYM(rb_intern("circular"));	rb_gc_register_address(&circular_sym);
     class_cache_sym = ID2SYM(rb_intern("class_cache"));	rb_gc_register_address(&class_cache_sym);
     compat_sym = ID2SYM(rb_intern("compat"));		rb_gc_register_address(&compat_sym);
     create_id_sym = ID2SYM(rb_intern("create_id"));	rb_gc_register_address(&create_id_sym);
     indent_sym = ID2SYM(rb_intern("indent"));		rb_gc_register_address(&indent_sym);
+    length_sym = ID2SYM(rb_intern("length"));		rb_gc_register_address(&length_sym);
+    mmap_sym = ID2SYM(rb_intern("mmap"));		rb_gc_register_address(&mmap_sym);
     mode_sym = ID2SYM(rb_intern("mode"));		rb_gc_register_address(&mode_sym);
     null_sym = ID2SYM(rb_intern("null"));		rb_gc_register_address(&null_sym);
     object_sym = ID2SYM(rb_intern("object"));		rb_gc_register_address(&object_sym);
+    offset_sym = ID2SYM(rb_intern("offset"));		rb_gc_register_address(&offset_sym);
     ruby_sym = ID2SYM(rb_intern("ruby"));		rb_gc_register_address(&ruby_sym);
     sec_prec_sym = ID2SYM(rb_intern("second_precision"));rb_gc_register_address(&sec_prec_sym);
+    float_prec_sym = ID2SYM(rb_intern("float_precision"));rb_gc_register_address(&float_prec_sym);
     strict_sym = ID2SYM(rb_intern("strict"));		rb_gc_register_address(&strict_sym);
+    threads_sym = ID2SYM(rb_intern("threads"));		rb_gc_register_address(&threads_sym);
+    lazy_sym = ID2SYM(rb_intern("lazy"));		rb_gc_register_address(&lazy_sym);
+    only_sym = ID2SYM(rb_intern("only"));		rb_gc_register_address(&only_sym);
+    tape_sym = ID2SYM(rb_intern("tape"));		rb_gc_register_address(&tape_sym);
     symbol_keys_sym = ID2SYM(rb_intern("symbol_keys"));	rb_gc_register_address(&symbol_keys_sym);
     time_format_sym = ID2SYM(rb_intern("time_format"));	rb_gc_register_address(&time_format_sym);
     unix_sym = ID2SYM(rb_intern("unix"));		rb_gc_register_address(&unix_sym);
     xmlschema_sym = ID2SYM(rb_intern("xmlschema"));	rb_gc_register_address(&xmlschema_sym);
 
     oj_slash_string = rb_str_new2("/");			rb_gc_register_address(&oj_slash_string);
+    // returned from a Oj::ScHandler or Oj::Saj start callback to skip the
+    // Hash or Array without any more callbacks
+    oj_skip_obj = rb_obj_freeze(rb_obj_alloc(rb_cObject));
+    rb_define_const(Oj, "SKIP", oj_skip_obj);
 
     oj_default_options.mode = ObjectMode;
 
     oj_hash_init();
     oj_odd_init();
+    oj_simd_init();
 
 #if SAFE_CACHE
     pthread_mutex_init(&oj_cache_mutex, 0);
 #endif
     oj_init_doc();
+    oj_init_lazy();
+    oj_init_parser();
+
+    oj_options_class = rb_define_class_under(Oj, "Options", rb_cObject);
+    rb_undef_alloc_func(oj_options_class);
+    rb_define_singleton_method(oj_options_class, "new", options_new, 1);
 }
 
 // mimic JSON documentation
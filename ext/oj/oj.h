@@ -109,9 +109,13 @@ typedef struct _Options {
     char	time_format;	// TimeFormat
     char	bigdec_as_num;	// YesNo
     char	bigdec_load;	// YesNo
+    char	tape;		// YesNo
+    char	cache_keys;	// YesNo
+    int		cache_str;	// cache String values up to this length, 0 for none
     const char	*create_id;	// 0 or string
     size_t	create_id_len;	// length of create_id
     int		sec_prec;	// second precision when dumping time
+    int		float_prec;	// significant digits when dumping floats, 0 for shortest
     DumpOpts	dump_opts;
 } *Options;
 
@@ -148,6 +152,8 @@ typedef struct _Leaf {
     uint8_t		type;
     uint8_t		parent_type;
     uint8_t		value_type;
+    uint32_t		klen;	   // key length, a key may hold a '\0'
+    uint32_t		len;	   // str length, a string may hold a '\0'
 } *Leaf;
 
 extern VALUE	oj_saj_parse(int argc, VALUE *argv, VALUE self);
@@ -157,18 +163,25 @@ extern VALUE	oj_strict_parse(int argc, VALUE *argv, VALUE self);
 extern VALUE	oj_compat_parse(int argc, VALUE *argv, VALUE self);
 extern VALUE	oj_object_parse(int argc, VALUE *argv, VALUE self);
 
-extern VALUE	oj_strict_parse_cstr(int argc, VALUE *argv, char *json);
-extern VALUE	oj_compat_parse_cstr(int argc, VALUE *argv, char *json);
-extern VALUE	oj_object_parse_cstr(int argc, VALUE *argv, char *json);
+extern VALUE	oj_strict_parse_cstr(int argc, VALUE *argv, char *json, size_t len);
+extern VALUE	oj_compat_parse_cstr(int argc, VALUE *argv, char *json, size_t len);
+extern VALUE	oj_object_parse_cstr(int argc, VALUE *argv, char *json, size_t len);
 
 extern void	oj_parse_options(VALUE ropts, Options copts);
+extern void	oj_parse_slice(VALUE ropts, const char **startp, const char **endp);
+extern int	oj_parse_threads(VALUE ropts);
+extern VALUE	oj_parse_only(VALUE ropts);
 
 extern void	oj_dump_obj_to_json(VALUE obj, Options copts, Out out);
 extern void	oj_write_obj_to_file(VALUE obj, const char *path, Options copts);
 extern void	oj_dump_leaf_to_json(Leaf leaf, Options copts, Out out);
 extern void	oj_write_leaf_to_file(Leaf leaf, const char *path, Options copts);
 
+extern VALUE	oj_lazy_load(VALUE input, VALUE ropts);
+
 extern void	oj_init_doc(void);
+extern void	oj_init_lazy(void);
+extern void	oj_init_parser(void);
 
 extern VALUE	Oj;
 extern struct _Options	oj_default_options;
@@ -183,11 +196,15 @@ extern VALUE	oj_bigdecimal_class;
 extern VALUE	oj_date_class;
 extern VALUE	oj_datetime_class;
 extern VALUE	oj_doc_class;
+extern VALUE	oj_lazy_array_class;
+extern VALUE	oj_lazy_hash_class;
+extern VALUE	oj_options_class;
 extern VALUE	oj_stringio_class;
 extern VALUE	oj_struct_class;
 extern VALUE	oj_time_class;
 
 extern VALUE	oj_slash_string;
+extern VALUE	oj_skip_obj;
 
 extern ID	oj_add_value_id;
 extern ID	oj_array_append_id;
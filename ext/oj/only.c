@@ -0,0 +1,220 @@
+/* only.c
+ * Copyright (c) 2013, Peter Ohler
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *  - Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ *  - Neither the name of Peter Ohler nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+
+#include "oj.h"
+#include "err.h"
+#include "parse.h"
+#include "only.h"
+
+// Splits a path into steps or, if steps is 0, just counts them. A leading
+// slash is optional, as it is for Oj::Doc.
+static int
+split_path(const char *path, size_t len, Step steps) {
+    const char	*end = path + len;
+    const char	*s;
+    int		cnt = 0;
+
+    if (path < end && '/' == *path) {
+	path++;
+    }
+    while (path < end) {
+	for (s = path; s < end && '/' != *s; s++) {
+	}
+	if (s == path) {
+	    rb_raise(rb_eArgError, ":only paths can not have empty steps.");
+	}
+	if (2 == s - path && '.' == *path && '.' == path[1]) {
+	    rb_raise(rb_eArgError, ":only paths can not move up with '..'.");
+	}
+	if (0 != steps) {
+	    Step	st = steps + cnt;
+	    const char	*c;
+
+	    st->str = path;
+	    st->len = s - path;
+	    st->wild = (1 == st->len && '*' == *path);
+	    st->index = 0;
+	    for (c = path; c < s && '0' <= *c && *c <= '9'; c++) {
+		st->index = st->index * 10 + (*c - '0');
+	    }
+	    if (c < s) {
+		st->index = 0;
+	    }
+	}
+	cnt++;
+	path = (s < end) ? s + 1 : s;
+    }
+    return cnt;
+}
+
+Only
+oj_only_new(VALUE paths) {
+    Only	only;
+    long	cnt;
+    long	i;
+    size_t	tlen = 0;
+    int		max = 0;
+    char	*t;
+
+    Check_Type(paths, T_ARRAY);
+    cnt = RARRAY_LEN(paths);
+    if (0 >= cnt || ONLY_MAX < cnt) {
+	rb_raise(rb_eArgError, ":only must have from 1 to %d paths.", ONLY_MAX);
+    }
+    for (i = 0; i < cnt; i++) {
+	VALUE	p = rb_ary_entry(paths, i);
+	int	n;
+
+	Check_Type(p, T_STRING);
+	n = split_path(RSTRING_PTR(p), RSTRING_LEN(p), 0);
+	if (max < n) {
+	    max = n;
+	}
+	tlen += RSTRING_LEN(p);
+    }
+    only = ALLOC(struct _Only);
+    only->cnt = (int)cnt;
+    only->max = max;
+    only->full_at = -1;
+    only->steps = ALLOC_N(struct _Step, cnt * max + 1);
+    only->ends = ALLOC_N(uint64_t, max + 1);
+    only->masks = ALLOC_N(uint64_t, max + 1);
+    only->counts = ALLOC_N(long, max + 1);
+    only->text = ALLOC_N(char, tlen + 1);
+    memset(only->ends, 0, sizeof(uint64_t) * (max + 1));
+    t = only->text;
+    for (i = 0; i < cnt; i++) {
+	VALUE	p = rb_ary_entry(paths, i);
+	size_t	len = RSTRING_LEN(p);
+	int	n;
+
+	memcpy(t, RSTRING_PTR(p), len);
+	n = split_path(t, len, only->steps + i * max);
+	only->ends[n] |= (uint64_t)1 << i;
+	t += len;
+    }
+    return only;
+}
+
+void
+oj_only_free(Only only) {
+    if (0 != only) {
+	xfree(only->steps);
+	xfree(only->ends);
+	xfree(only->masks);
+	xfree(only->counts);
+	xfree(only->text);
+	xfree(only);
+    }
+}
+
+// Returns the paths in mask that step d accepts for the element at a 1 based
+// index or with a key.
+static uint64_t
+match(Only only, int d, uint64_t mask, long index, const char *key, size_t klen) {
+    uint64_t	m = 0;
+    int		i;
+
+    for (i = 0; i < only->cnt; i++) {
+	uint64_t	bit = (uint64_t)1 << i;
+	Step		st;
+
+	if (0 == (mask & bit)) {
+	    continue;
+	}
+	st = only->steps + i * only->max + d;
+	if (st->wild) {
+	    m |= bit;
+	} else if (0 == key) {
+	    if (index == st->index) {
+		m |= bit;
+	    }
+	} else if (klen == st->len && 0 == memcmp(key, st->str, klen)) {
+	    m |= bit;
+	}
+    }
+    return m;
+}
+
+// Called with pi->cur on the next token. Returns 1 if it was a value off the
+// :only paths and has been skipped.
+int
+oj_only_skip(ParseInfo pi) {
+    Only	only = pi->only;
+    Val		parent = stack_peek(&pi->stack);
+    char	c = *pi->cur;
+    uint64_t	mask;
+    int		d;
+
+    switch (c) {
+    case '}': case ']': case ',': case ':': case '/': case '\0':
+	return 0;
+    default:
+	break;
+    }
+    if (0 == parent) { // a new document
+	only->masks[0] = (ONLY_MAX == only->cnt) ? ~(uint64_t)0 : (((uint64_t)1 << only->cnt) - 1);
+	only->counts[0] = 0;
+	only->full_at = (0 != only->ends[0]) ? 0 : -1;
+	return 0;
+    }
+    d = (int)stack_size(&pi->stack) - 1;
+    if (0 <= only->full_at && only->full_at <= d) {
+	return 0;
+    }
+    switch (parent->next) {
+    case NEXT_ARRAY_NEW:
+    case NEXT_ARRAY_ELEMENT:
+	only->counts[d]++;
+	mask = match(only, d, only->masks[d], only->counts[d], 0, 0);
+	break;
+    case NEXT_HASH_VALUE:
+	mask = match(only, d, only->masks[d], 0, parent->key, parent->klen);
+	break;
+    default:
+	return 0; // a key or out of place, either way not a value to skip
+    }
+    if (0 != (mask & only->ends[d + 1])) {
+	only->full_at = d + 1;
+	return 0;
+    }
+    only->full_at = -1;
+    if (0 != mask && ('{' == c || '[' == c)) {
+	only->masks[d + 1] = mask;
+	only->counts[d + 1] = 0;
+	return 0;
+    }
+    oj_skip_value(pi);
+    parent->next = (NEXT_HASH_VALUE == parent->next) ? NEXT_HASH_COMMA : NEXT_ARRAY_COMMA;
+
+    return 1;
+}
@@ -0,0 +1,65 @@
+/* only.h
+ * Copyright (c) 2013, Peter Ohler
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *  - Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ *  - Neither the name of Peter Ohler nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __OJ_ONLY_H__
+#define __OJ_ONLY_H__
+
+#include "ruby.h"
+#include <stdint.h>
+
+#define ONLY_MAX	64
+
+// One step of an :only path, a Hash key, a 1 based Array index, or '*'.
+typedef struct _Step {
+    const char	*str;
+    size_t	len;
+    long	index;	// 0 if not all digits
+    int		wild;
+} *Step;
+
+// The paths given with the :only option. The values on the way to a path
+// are kept and everything else is skipped without being parsed. While
+// parsing, masks has a bit set for each path that still matches the open
+// Array or Hash at each depth.
+typedef struct _Only {
+    int		cnt;	   // number of paths
+    int		max;	   // most steps in a path
+    int		full_at;   // depth everything is kept from or -1
+    Step	steps;	   // cnt rows of max steps
+    uint64_t	*ends;	   // paths that end at each depth
+    uint64_t	*masks;	   // paths that still match at each depth
+    long	*counts;   // elements started in the Array at each depth
+    char	*text;	   // copy of the paths that steps point into
+} *Only;
+
+extern Only	oj_only_new(VALUE paths);
+extern void	oj_only_free(Only only);
+
+#endif /* __OJ_ONLY_H__ */
@@ -38,6 +38,11 @@
 #include "parse.h"
 #include "buf.h"
 #include "val_stack.h"
+#include "simd.h"
+#include "num.h"
+#include "mapped_file.h"
+#include "hash.h"
+#include "encode.h"
 
 // Workaround in case INFINITY is not defined in math.h or if the OS is CentOS
 #define OJ_INFINITY	(1.0/0.0)
@@ -48,30 +53,32 @@
 #define NUM_MAX		(FIXNUM_MAX >> 8)
 #endif
 #define EXP_MAX		1023
-#define DEC_MAX		14
+#define DEC_MAX		17
+#define DIV_MAX		1000000000000000000LL
+#define UINT_DIG_MAX	19
 
-static void
+inline static void
 next_non_white(ParseInfo pi) {
-    for (; 1; pi->cur++) {
-	switch(*pi->cur) {
-	case ' ':
-	case '\t':
-	case '\f':
-	case '\n':
-	case '\r':
-	    break;
-	default:
-	    return;
-	}
-    }
+    pi->cur = oj_skip_white(pi->cur);
+}
+
+// Stops the parse at start, the beginning of a token that runs into the end
+// of the input. The token is parsed again when more input arrives.
+inline static void
+pause_at(ParseInfo pi, const char *start) {
+    pi->cur = start;
+    pi->end = start;
 }
 
+// entered after the /
 static void
 skip_comment(ParseInfo pi) {
-    if ('*' == *pi->cur) {
+    const char	*start = pi->cur - 1;
+
+    if (pi->cur < pi->end && '*' == *pi->cur) {
 	pi->cur++;
-	for (; '\0' != *pi->cur; pi->cur++) {
-	    if ('*' == *pi->cur && '/' == *(pi->cur + 1)) {
+	for (; pi->cur < pi->end && '\0' != *pi->cur; pi->cur++) {
+	    if ('*' == *pi->cur && pi->cur + 1 < pi->end && '/' == *(pi->cur + 1)) {
 		pi->cur += 2;
 		return;
 	    } else if ('\0' == *pi->cur) {
@@ -79,8 +86,11 @@ skip_comment(ParseInfo pi) {
 		return;
 	    }
 	}
-    } else if ('/' == *pi->cur) {
-	for (; 1; pi->cur++) {
+	if (pi->more && pi->end <= pi->cur) {
+	    pause_at(pi, start);
+	}
+    } else if (pi->cur < pi->end && '/' == *pi->cur) {
+	for (; pi->cur < pi->end; pi->cur++) {
 	    switch (*pi->cur) {
 	    case '\n':
 	    case '\r':
@@ -91,6 +101,11 @@ skip_comment(ParseInfo pi) {
 		break;
 	    }
 	}
+	if (pi->more) {
+	    pause_at(pi, start);
+	}
+    } else if (pi->more && pi->end <= pi->cur) {
+	pause_at(pi, start);
     } else {
 	oj_set_error_at(pi, oj_parse_error_class, __FILE__, __LINE__, "invalid comment format");
     }
@@ -111,10 +126,6 @@ add_value(ParseInfo pi, VALUE rval) {
 	    break;
 	case NEXT_HASH_VALUE:
 	    pi->hash_set_value(pi, parent->key, parent->klen, rval);
-	    if (0 != parent->key && (parent->key < pi->json || pi->cur < parent->key)) {
-		xfree((char*)parent->key);
-		parent->key = 0;
-	    }
 	    parent->next = NEXT_HASH_COMMA;
 	    break;
 	case NEXT_HASH_NEW:
@@ -132,7 +143,9 @@ add_value(ParseInfo pi, VALUE rval) {
 
 static void
 read_null(ParseInfo pi) {
-    if ('u' == *pi->cur++ && 'l' == *pi->cur++ && 'l' == *pi->cur++) {
+    if (pi->more && pi->end - pi->cur < 3) {
+	pause_at(pi, pi->cur - 1);
+    } else if (3 <= pi->end - pi->cur && 'u' == *pi->cur++ && 'l' == *pi->cur++ && 'l' == *pi->cur++) {
 	add_value(pi, Qnil);
     } else {
 	oj_set_error_at(pi, oj_parse_error_class, __FILE__, __LINE__, "expected null");
@@ -141,7 +154,9 @@ read_null(ParseInfo pi) {
 
 static void
 read_true(ParseInfo pi) {
-    if ('r' == *pi->cur++ && 'u' == *pi->cur++ && 'e' == *pi->cur++) {
+    if (pi->more && pi->end - pi->cur < 3) {
+	pause_at(pi, pi->cur - 1);
+    } else if (3 <= pi->end - pi->cur && 'r' == *pi->cur++ && 'u' == *pi->cur++ && 'e' == *pi->cur++) {
 	add_value(pi, Qtrue);
     } else {
 	oj_set_error_at(pi, oj_parse_error_class, __FILE__, __LINE__, "expected true");
@@ -150,7 +165,9 @@ read_true(ParseInfo pi) {
 
 static void
 read_false(ParseInfo pi) {
-    if ('a' == *pi->cur++ && 'l' == *pi->cur++ && 's' == *pi->cur++ && 'e' == *pi->cur++) {
+    if (pi->more && pi->end - pi->cur < 4) {
+	pause_at(pi, pi->cur - 1);
+    } else if (4 <= pi->end - pi->cur && 'a' == *pi->cur++ && 'l' == *pi->cur++ && 's' == *pi->cur++ && 'e' == *pi->cur++) {
 	add_value(pi, Qfalse);
     } else {
 	oj_set_error_at(pi, oj_parse_error_class, __FILE__, __LINE__, "expected false");
@@ -162,6 +179,10 @@ read_hex(ParseInfo pi, const char *h) {
     uint32_t	b = 0;
     int		i;
 
+    if (pi->end - h < 4) {
+	oj_set_error_at(pi, oj_parse_error_class, __FILE__, __LINE__, "invalid hex character");
+	return 0;
+    }
     for (i = 0; i < 4; i++, h++) {
 	b = b << 4;
 	if ('0' <= *h && *h <= '9') {
@@ -225,12 +246,16 @@ read_escaped_str(ParseInfo pi, const char *start) {
     if (0 < cnt) {
 	buf_append_string(&buf, start, cnt);
     }
-    for (s = pi->cur; '"' != *s; s++) {
-	if ('\0' == *s) {
+    // s is always at a '"', '\\', '\0', or past the end at the top of the
+    // loop. The plain runs between escapes are copied in one step.
+    for (s = pi->cur; pi->end <= s || '"' != *s;) {
+	const char	*run;
+
+	if (pi->end - 1 <= s || '\0' == *s) {
 	    oj_set_error_at(pi, oj_parse_error_class, __FILE__, __LINE__, "quoted string not terminated");
 	    buf_cleanup(&buf);
 	    return;
-	} else if ('\\' == *s) {
+	} else {
 	    s++;
 	    switch (*s) {
 	    case 'n':	buf_append(&buf, '\n');	break;
@@ -280,10 +305,14 @@ read_escaped_str(ParseInfo pi, const char *start) {
 		buf_cleanup(&buf);
 		return;
 	    }
-	} else {
-	    buf_append(&buf, *s);
+	    run = ++s;
+	    s = oj_scan_string(s);
+	    if (run < s) {
+		buf_append_string(&buf, run, s - run);
+	    }
 	}
     }
+    *buf.tail = '\0';
     if (0 == parent) {
 	pi->add_cstr(pi, buf.head, buf_len(&buf), start);
     } else {
@@ -295,18 +324,14 @@ read_escaped_str(ParseInfo pi, const char *start) {
 	    break;
 	case NEXT_HASH_NEW:
 	case NEXT_HASH_KEY:
-	    // key will not be between pi->json and pi->cur.
-	    parent->key = strdup(buf.head);
+	    // the unescaped key is only in buf so it is copied
+	    parent->key = arena_strndup(&pi->arena, buf.head, buf_len(&buf));
 	    parent->klen = buf_len(&buf);
 	    parent->k1 = *start;
 	    parent->next = NEXT_HASH_COLON;
 	    break;
 	case NEXT_HASH_VALUE:
 	    pi->hash_set_cstr(pi, parent->key, parent->klen, buf.head, buf_len(&buf), start);
-	    if (0 != parent->key && (parent->key < pi->json || pi->cur < parent->key)) {
-		xfree((char*)parent->key);
-		parent->key = 0;
-	    }
 	    parent->next = NEXT_HASH_COMMA;
 	    break;
 	case NEXT_HASH_COMMA:
@@ -322,19 +347,43 @@ read_escaped_str(ParseInfo pi, const char *start) {
     buf_cleanup(&buf);
 }
 
+// Returns non-zero if the string with an escape at s is closed before
+// pi->end. A '\0' is reported as an error by read_escaped_str().
+static int
+escaped_str_closed(ParseInfo pi, const char *s) {
+    while (s < pi->end && '"' != *s) {
+	if ('\0' == *s) {
+	    return 1;
+	}
+	s += 2;
+	if (pi->end <= s) {
+	    return 0;
+	}
+	s = oj_scan_string(s);
+    }
+    return s < pi->end;
+}
+
 static void
 read_str(ParseInfo pi) {
     const char	*str = pi->cur;
     Val		parent = stack_peek(&pi->stack);
 
-    for (; '"' != *pi->cur; pi->cur++) {
-	if ('\0' == *pi->cur) {
-	    oj_set_error_at(pi, oj_parse_error_class, __FILE__, __LINE__, "quoted string not terminated");
+    pi->cur = oj_scan_string(pi->cur);
+    if (pi->end <= pi->cur || '\0' == *pi->cur) {
+	if (pi->more && pi->end <= pi->cur) {
+	    pause_at(pi, str - 1);
 	    return;
-	} else if ('\\' == *pi->cur) {
-	    read_escaped_str(pi, str);
+	}
+	oj_set_error_at(pi, oj_parse_error_class, __FILE__, __LINE__, "quoted string not terminated");
+	return;
+    } else if ('\\' == *pi->cur) {
+	if (pi->more && !escaped_str_closed(pi, pi->cur)) {
+	    pause_at(pi, str - 1);
 	    return;
 	}
+	read_escaped_str(pi, str);
+	return;
     }
     if (0 == parent) { // simple add
 	pi->add_cstr(pi, str, pi->cur - str, str);
@@ -354,10 +403,6 @@ read_str(ParseInfo pi) {
 	    break;
 	case NEXT_HASH_VALUE:
 	    pi->hash_set_cstr(pi, parent->key, parent->klen, str, pi->cur - str, str);
-	    if (0 != parent->key && (parent->key < pi->json || pi->cur < parent->key)) {
-		xfree((char*)parent->key);
-		parent->key = 0;
-	    }
 	    parent->next = NEXT_HASH_COMMA;
 	    break;
 	case NEXT_HASH_COMMA:
@@ -372,96 +417,151 @@ read_str(ParseInfo pi) {
     pi->cur++; // move past "
 }
 
-static void
-read_num(ParseInfo pi) {
-    struct _NumInfo	ni;
-    Val			parent = stack_peek(&pi->stack);
-    int			zero_cnt = 0;
-
-    ni.str = pi->cur;
-    ni.i = 0;
-    ni.num = 0;
-    ni.div = 1;
-    ni.len = 0;
-    ni.exp = 0;
-    ni.dec_cnt = 0;
-    ni.big = 0;
-    ni.infinity = 0;
-    ni.neg = 0;
-
-    if ('-' == *pi->cur) {
-	pi->cur++;
-	ni.neg = 1;
-    } else if ('+' == *pi->cur) {
-	pi->cur++;
+// The scan behind oj_num_read(), inlined into read_num().
+inline static const char*
+num_read(NumInfo ni, const char *s, const char *end) {
+    const char	*digits;
+    uint64_t	u = 0;
+#ifdef OJ_SWAR
+    uint64_t	v8;
+#endif
+    int		zero_cnt = 0;
+
+    ni->str = s;
+    ni->i = 0;
+    ni->num = 0;
+    ni->div = 1;
+    ni->len = 0;
+    ni->exp = 0;
+    ni->dec_cnt = 0;
+    ni->big = 0;
+    ni->infinity = 0;
+    ni->neg = 0;
+
+    if ('-' == *s) {
+	s++;
+	ni->neg = 1;
+    } else if ('+' == *s) {
+	s++;
     }
-    if ('I' == *pi->cur) {
-	if (0 != strncmp("Infinity", pi->cur, 8)) {
-	    oj_set_error_at(pi, oj_parse_error_class, __FILE__, __LINE__, "not a number or other value");
-	    return;
+    if (s < end && 'I' == *s) {
+	ni->infinity = 1;
+	return s;
+    }
+    // Up to 19 digits always fit in a uint64_t. Anything longer can not be a
+    // fixnum so the value is left for the string conversion.
+    digits = s;
+#ifdef OJ_SWAR
+    while (s - digits < UINT_DIG_MAX - 8 && oj_num_load8(s, end, &v8) && oj_num_is8(v8)) {
+	u = u * 100000000ULL + oj_num_parse8(v8);
+	s += 8;
+    }
+#endif
+    for (; s < end && '0' <= *s && *s <= '9'; s++) {
+	if (s - digits < UINT_DIG_MAX) {
+	    u = u * 10 + (*s - '0');
 	}
-	pi->cur += 8;
-	ni.infinity = 1;
-	return;
     }
-    for (; '0' <= *pi->cur && *pi->cur <= '9'; pi->cur++) {
-	ni.dec_cnt++;
-	if (ni.big) {
-	    ni.big++;
-	} else {
-	    int	d = (*pi->cur - '0');
+    ni->dec_cnt = (0 == u) ? 0 : (int)(s - digits);
+    if (UINT_DIG_MAX < ni->dec_cnt || (uint64_t)LONG_MAX < u) {
+	ni->big = 1;
+    } else {
+	ni->i = (int64_t)u;
+    }
+    if (s < end && ('.' == *s || 'e' == *s || 'E' == *s)) {
+	const char	*z;
 
-	    if (0 == d) {
-		zero_cnt++;
-	    } else {
-		zero_cnt = 0;
-	    }
-	    ni.i = ni.i * 10 + d;
-	    if (LONG_MAX <= ni.i || DEC_MAX < ni.dec_cnt - zero_cnt) {
-		ni.big = 1;
-	    }
+	// Trailing zeros do not count against the decimal precision.
+	for (z = s; digits < z && '0' == *(z - 1); z--) {
+	    zero_cnt++;
+	}
+	if (DEC_MAX < ni->dec_cnt - zero_cnt) {
+	    ni->big = 1;
 	}
     }
-    if ('.' == *pi->cur) {
-	pi->cur++;
-	for (; '0' <= *pi->cur && *pi->cur <= '9'; pi->cur++) {
-	    int	d = (*pi->cur - '0');
+    if (s < end && '.' == *s) {
+	s++;
+	for (; s < end && '0' <= *s && *s <= '9'; s++) {
+	    int	d = (*s - '0');
 
 	    if (0 == d) {
 		zero_cnt++;
 	    } else {
 		zero_cnt = 0;
 	    }
-	    ni.dec_cnt++;
-	    ni.num = ni.num * 10 + d;
-	    ni.div *= 10;
-	    if (LONG_MAX <= ni.div || DEC_MAX < ni.dec_cnt - zero_cnt) {
-		ni.big = 1;
+	    // Leading zeros are not significant and only count against the
+	    // divisor so a 17 digit fraction less than 1 is still a Float.
+	    if (0 != ni->i || 0 != ni->num || 0 != d) {
+		ni->dec_cnt++;
+	    }
+	    // Another digit would overflow the divisor so the number is
+	    // left to BigDecimal or the Ruby conversion.
+	    if (DIV_MAX <= ni->div) {
+		ni->big = 1;
+	    } else {
+		ni->num = ni->num * 10 + d;
+		ni->div *= 10;
+	    }
+	    if (DEC_MAX < ni->dec_cnt - zero_cnt) {
+		ni->big = 1;
 	    }
 	}
     }
-    if ('e' == *pi->cur || 'E' == *pi->cur) {
+    if (s < end && ('e' == *s || 'E' == *s)) {
 	int	eneg = 0;
 
-	pi->cur++;
-	if ('-' == *pi->cur) {
-	    pi->cur++;
+	s++;
+	if (s < end && '-' == *s) {
+	    s++;
 	    eneg = 1;
-	} else if ('+' == *pi->cur) {
-	    pi->cur++;
+	} else if (s < end && '+' == *s) {
+	    s++;
 	}
-	for (; '0' <= *pi->cur && *pi->cur <= '9'; pi->cur++) {
-	    ni.exp = ni.exp * 10 + (*pi->cur - '0');
-	    if (EXP_MAX <= ni.exp) {
-		ni.big = 1;
+	for (; s < end && '0' <= *s && *s <= '9'; s++) {
+	    ni->exp = ni->exp * 10 + (*s - '0');
+	    if (EXP_MAX <= ni->exp) {
+		ni->big = 1;
 	    }
 	}
 	if (eneg) {
-	    ni.exp = -ni.exp;
+	    ni->exp = -ni->exp;
+	}
+    }
+    ni->dec_cnt -= zero_cnt;
+    ni->len = s - ni->str;
+
+    return s;
+}
+
+const char*
+oj_num_read(NumInfo ni, const char *s, const char *end) {
+    return num_read(ni, s, end);
+}
+
+static void
+read_num(ParseInfo pi) {
+    struct _NumInfo	ni;
+    Val			parent = stack_peek(&pi->stack);
+    const char		*end = pi->end;
+
+    pi->cur = num_read(&ni, pi->cur, end);
+    if (ni.infinity) {
+	if (pi->more && end - pi->cur < 8) {
+	    pause_at(pi, ni.str);
+	    return;
+	}
+	if (end - pi->cur < 8 || 0 != strncmp("Infinity", pi->cur, 8)) {
+	    oj_set_error_at(pi, oj_parse_error_class, __FILE__, __LINE__, "not a number or other value");
+	    return;
 	}
+	pi->cur += 8;
+	return;
+    }
+    if (pi->more && end <= pi->cur) {
+	// The number might continue in the next input.
+	pause_at(pi, ni.str);
+	return;
     }
-    ni.dec_cnt -= zero_cnt;
-    ni.len = pi->cur - ni.str;
     if (Yes == pi->options.bigdec_load) {
 	ni.big = 1;
     }
@@ -476,10 +576,6 @@ read_num(ParseInfo pi) {
 	    break;
 	case NEXT_HASH_VALUE:
 	    pi->hash_set_num(pi, parent->key, parent->klen, &ni);
-	    if (0 != parent->key && (parent->key < pi->json || pi->cur < parent->key)) {
-		xfree((char*)parent->key);
-		parent->key = 0;
-	    }
 	    parent->next = NEXT_HASH_COMMA;
 	    break;
 	default:
@@ -489,24 +585,124 @@ read_num(ParseInfo pi) {
     }
 }
 
+// Moves past the value at pi->cur by balancing brackets and quotes. Nothing
+// in it is checked or created. If the value runs into the end and pi->more is
+// set the parse is paused at the start of the value.
+void
+oj_skip_value(ParseInfo pi) {
+    const char	*s = pi->cur;
+
+    switch (*s) {
+    case '{':
+    case '[':
+	s = oj_skip_container(s);
+	if (0 == s || pi->end < s) {
+	    if (pi->more) {
+		pause_at(pi, pi->cur);
+		return;
+	    }
+	    pi->cur = pi->end;
+	    oj_set_error_at(pi, oj_parse_error_class, __FILE__, __LINE__, "value not terminated");
+	    return;
+	}
+	break;
+    case '"':
+	for (s = oj_scan_string(s + 1); '\\' == *s && s + 1 < pi->end; s = oj_scan_string(s + 2)) {
+	}
+	if (pi->end <= s || '"' != *s) {
+	    if (pi->more) {
+		pause_at(pi, pi->cur);
+		return;
+	    }
+	    pi->cur = s;
+	    oj_set_error_at(pi, oj_parse_error_class, __FILE__, __LINE__, "quoted string not terminated");
+	    return;
+	}
+	s++;
+	break;
+    default:
+	// a number, true, false, or null
+	for (; s < pi->end; s++) {
+	    switch (*s) {
+	    case ',': case '}': case ']': case '/': case '\0':
+	    case ' ': case '\t': case '\n': case '\r': case '\f':
+		goto done;
+	    default:
+		break;
+	    }
+	}
+	if (pi->more) {
+	    pause_at(pi, pi->cur);
+	    return;
+	}
+    done:
+	break;
+    }
+    pi->cur = s;
+}
+
+// Called with pi->cur just past the opening bracket when a start callback
+// returns Oj::SKIP. The container is passed over with no more callbacks and
+// the parent moves on as if a value had been added to it. A container cut off
+// by the end of a chunk is skipped again from its start with the next chunk.
+static void
+skip_container(ParseInfo pi) {
+    Val		parent = stack_peek(&pi->stack);
+    const char	*end = pi->end;
+    char	next = NEXT_NONE;
+
+    pi->skipping = 0;
+    if (0 != parent) {
+	switch (parent->next) {
+	case NEXT_ARRAY_NEW:
+	case NEXT_ARRAY_ELEMENT:
+	    next = NEXT_ARRAY_COMMA;
+	    break;
+	case NEXT_HASH_VALUE:
+	    next = NEXT_HASH_COMMA;
+	    break;
+	default:
+	    oj_set_error_at(pi, oj_parse_error_class, __FILE__, __LINE__, "expected %s", oj_stack_next_string(parent->next));
+	    return;
+	}
+    }
+    pi->cur--;
+    oj_skip_value(pi);
+    if (end != pi->end) {
+	// paused, the start callback is not called again on resume
+	pi->skipping = 1;
+	return;
+    }
+    if (0 != parent && !err_has(&pi->err)) {
+	parent->next = next;
+    }
+}
+
 static void
 array_start(ParseInfo pi) {
     VALUE	v = Qnil;
 
     v = pi->start_array(pi);
+    if (oj_skip_obj == v) {
+	skip_container(pi);
+	return;
+    }
     stack_push(&pi->stack, v, NEXT_ARRAY_NEW);
 }
 
 static void
 array_end(ParseInfo pi) {
-    Val	array = stack_pop(&pi->stack);
+    Val	array = stack_peek(&pi->stack);
 
+    // leave array on stack until the end callback has finished it
     if (0 == array) {
 	oj_set_error_at(pi, oj_parse_error_class, __FILE__, __LINE__, "unexpected array close");
     } else if (NEXT_ARRAY_COMMA != array->next && NEXT_ARRAY_NEW != array->next) {
+	stack_pop(&pi->stack);
 	oj_set_error_at(pi, oj_parse_error_class, __FILE__, __LINE__, "expected %s, not an array close", oj_stack_next_string(array->next));
     } else {
 	pi->end_array(pi);
+	stack_pop(&pi->stack);
 	add_value(pi, array->val);
     }
 }
@@ -516,6 +712,10 @@ hash_start(ParseInfo pi) {
     VALUE	v = Qnil;
 
     v = pi->start_hash(pi);
+    if (oj_skip_obj == v) {
+	skip_container(pi);
+	return;
+    }
     stack_push(&pi->stack, v, NEXT_HASH_NEW);
 }
 
@@ -561,16 +761,41 @@ colon(ParseInfo pi) {
     }
 }
 
-void
-oj_parse2(ParseInfo pi) {
-    pi->cur = pi->json;
-    err_init(&pi->err);
-    stack_init(&pi->stack);
+// Yields the top level value just completed, if there is one, and clears it
+// so the next document starts fresh.
+static void
+yield_doc(ParseInfo pi) {
+    VALUE	doc = pi->stack.head->val;
+
+    if (Qundef == doc || !stack_empty(&pi->stack)) {
+	return;
+    }
+    pi->stack.head->val = Qundef;
+    arena_reset(&pi->arena);
+    rb_yield(doc);
+}
+
+static void
+parse_loop(ParseInfo pi) {
     while (1) {
 	next_non_white(pi);
+	if (pi->end <= pi->cur) {
+	    pi->cur = pi->end;
+	    return;
+	}
+	if (0 != pi->only && oj_only_skip(pi)) {
+	    if (err_has(&pi->err)) {
+		return;
+	    }
+	    continue;
+	}
 	switch (*pi->cur++) {
 	case '{':
-	    hash_start(pi);
+	    if (pi->skipping) {
+		skip_container(pi);
+	    } else {
+		hash_start(pi);
+	    }
 	    break;
 	case '}':
 	    hash_end(pi);
@@ -579,7 +804,11 @@ oj_parse2(ParseInfo pi) {
 	    colon(pi);
 	    break;
 	case '[':
-	    array_start(pi);
+	    if (pi->skipping) {
+		skip_container(pi);
+	    } else {
+		array_start(pi);
+	    }
 	    break;
 	case ']':
 	    array_end(pi);
@@ -628,7 +857,203 @@ oj_parse2(ParseInfo pi) {
 	if (err_has(&pi->err)) {
 	    return;
 	}
+	if (pi->yield_docs) {
+	    yield_doc(pi);
+	}
+    }
+}
+
+void
+oj_parse2(ParseInfo pi) {
+    pi->cur = pi->json;
+    pi->more = 0;
+    pi->skipping = 0;
+    err_init(&pi->err);
+    stack_init(&pi->stack);
+    parse_loop(pi);
+}
+
+/* Continues a parse with the input from pi->json to pi->end. The stack and
+ * error state are kept from the previous call. When pi->more is set a token
+ * that runs into the end is left unparsed and pi->cur is left at its start.
+ * Otherwise pi->cur is at the end on return.
+ */
+void
+oj_parse_chunk(ParseInfo pi) {
+    pi->cur = pi->json;
+    parse_loop(pi);
+}
+
+// A scalar must be followed by nothing but white space up to the next
+// entry on the tape or the end of the document.
+inline static void
+check_scalar_end(ParseInfo pi, const char *next) {
+    pi->cur = oj_skip_white(pi->cur);
+    if (pi->end < pi->cur) {
+	pi->cur = pi->end;
+    }
+    if (next != pi->cur) {
+	pi->cur++;
+	oj_set_error_at(pi, oj_parse_error_class, __FILE__, __LINE__, "unexpected character");
+    }
+}
+
+// Handles the tape entry at pi->cur. The next entry, or the end of the
+// document, is needed to validate scalars. Returns 0 on error.
+inline static int
+tape_step(ParseInfo pi, const char *next) {
+    switch (*pi->cur++) {
+    case '{':
+	hash_start(pi);
+	break;
+    case '}':
+	hash_end(pi);
+	break;
+    case ':':
+	colon(pi);
+	break;
+    case '[':
+	array_start(pi);
+	break;
+    case ']':
+	array_end(pi);
+	break;
+    case ',':
+	comma(pi);
+	break;
+    case '"':
+	read_str(pi);
+	break;
+    case '+':
+    case '-':
+    case '0':
+    case '1':
+    case '2':
+    case '3':
+    case '4':
+    case '5':
+    case '6':
+    case '7':
+    case '8':
+    case '9':
+    case 'I':
+	pi->cur--;
+	read_num(pi);
+	if (!err_has(&pi->err)) {
+	    check_scalar_end(pi, next);
+	}
+	break;
+    case 't':
+	read_true(pi);
+	if (!err_has(&pi->err)) {
+	    check_scalar_end(pi, next);
+	}
+	break;
+    case 'f':
+	read_false(pi);
+	if (!err_has(&pi->err)) {
+	    check_scalar_end(pi, next);
+	}
+	break;
+    case 'n':
+	read_null(pi);
+	if (!err_has(&pi->err)) {
+	    check_scalar_end(pi, next);
+	}
+	break;
+    default:
+	oj_set_error_at(pi, oj_parse_error_class, __FILE__, __LINE__, "unexpected character");
+	return 0;
+    }
+    return !err_has(&pi->err);
+}
+
+/* Stage two of the tape parser. The structural index built by
+ * oj_tape_fill() is walked and each entry is handed to the same handlers
+ * oj_parse2() uses so the callbacks see no difference. If a comment stops
+ * the indexing the rest of the document is parsed a byte at a time from the
+ * last entry.
+ */
+void
+oj_parse_tape(ParseInfo pi) {
+    size_t	len = pi->end - pi->json;
+
+    if ((size_t)UINT32_MAX <= len) {
+	oj_parse2(pi);
+	return;
+    }
+    pi->more = 0;
+    pi->skipping = 0;
+    err_init(&pi->err);
+    stack_init(&pi->stack);
+    oj_tape_start(&pi->tape, pi->json, len);
+    oj_parse_tape_walk(pi, &pi->tape);
+}
+
+/* Walks a tape that may already hold some or all of its entries, filling
+ * more windows as needed. Tape offsets are relative to tape->json, which is
+ * not always pi->json, and the stack is carried over from the previous walk
+ * so a document can span two tapes.
+ */
+void
+oj_parse_tape_walk(ParseInfo pi, Tape tape) {
+    const uint32_t	*ip = tape->idx;
+    const uint32_t	*end = tape->idx + tape->cnt;
+    const char		*json = tape->json;
+    const char		*after = json; // entries before this were skipped over
+
+    pi->cur = json;
+    while (1) {
+	// The last entry is held back until the next window is indexed so
+	// there is always a next entry to check scalars against.
+	for (; ip + 1 < end; ip++) {
+	    if (json + *ip < after) {
+		continue;
+	    }
+	    pi->cur = json + *ip;
+	    if (!tape_step(pi, json + ip[1])) {
+		return;
+	    }
+	    after = pi->cur;
+	    if (pi->yield_docs) {
+		yield_doc(pi);
+	    }
+	}
+	if (tape->stop) {
+	    if (ip < end && after <= json + *ip) {
+		pi->cur = json + *ip;
+	    }
+	    parse_loop(pi);
+	    return;
+	}
+	if (tape->pos < tape->len) {
+	    oj_tape_fill(tape, ip);
+	    ip = tape->idx;
+	    end = ip + tape->cnt;
+	    continue;
+	}
+	if (ip < end && after <= json + *ip) {
+	    pi->cur = json + *ip;
+	    if (!tape_step(pi, json + tape->len)) {
+		return;
+	    }
+	    if (pi->yield_docs) {
+		yield_doc(pi);
+	    }
+	}
+	break;
+    }
+    pi->cur = json + tape->len;
+}
+
+// String values no longer than the :cache_str option are shared frozen
+// Strings.
+VALUE
+oj_cstr_to_value(ParseInfo pi, const char *str, size_t len) {
+    if (0 < pi->options.cache_str && len <= (size_t)pi->options.cache_str) {
+	return oj_str_cache_get(str, len);
     }
+    return oj_encode(rb_str_new(str, len));
 }
 
 VALUE
@@ -668,15 +1093,7 @@ oj_num_as_value(NumInfo ni) {
 	if (ni->big) {
 	    rnum = rb_funcall(oj_bigdecimal_class, oj_new_id, 1, rb_str_new(ni->str, ni->len));
 	} else {
-	    double	d = (double)ni->i + (double)ni->num / (double)ni->div;
-
-	    if (ni->neg) {
-		d = -d;
-	    }
-	    if (0 != ni->exp) {
-		d *= pow(10.0, ni->exp);
-	    }
-	    rnum = rb_float_new(d);
+	    rnum = rb_float_new(oj_num_to_double(ni->neg, ni->i, ni->num, ni->div, ni->exp, ni->str, ni->len));
 	}
     }
     return rnum;
@@ -696,18 +1113,84 @@ oj_set_error_at(ParseInfo pi, VALUE err_clas, const char* file, int line, const
 
 static VALUE
 protect_parse(VALUE pip) {
-    oj_parse2((ParseInfo)pip);
+    ParseInfo	pi = (ParseInfo)pip;
+
+    if (0 != pi->only) {
+	// values are skipped byte by byte so an index would be wasted
+	oj_parse2(pi);
+    } else if (1 < pi->threads) {
+	oj_parse_lines(pi);
+    } else if (Yes == pi->options.tape) {
+	oj_parse_tape(pi);
+    } else {
+	oj_parse2(pi);
+    }
 
     return Qnil;
 }
 
+// Marks the values only the parser holds, the stack, odd object arguments,
+// and circular references, so GC can run while a document is built.
+void
+oj_parse_mark(void *ptr) {
+    ParseInfo	pi = (ParseInfo)ptr;
+    Val		v;
+
+    rb_gc_mark(pi->stack.head->val);
+    for (v = pi->stack.head; v < pi->stack.tail; v++) {
+	rb_gc_mark(v->val);
+	if (0 != v->odd_args) {
+	    int	i;
+
+	    for (i = v->odd_args->odd->attr_cnt - 1; 0 <= i; i--) {
+		rb_gc_mark(v->odd_args->args[i]);
+	    }
+	}
+    }
+    if (pi->stack.vals < pi->stack.vtail) {
+	rb_gc_mark_locations(pi->stack.vals, pi->stack.vtail);
+    }
+    if (0 != pi->circ_array) {
+	unsigned long	i;
+
+	for (i = 0; i < pi->circ_array->cnt; i++) {
+	    rb_gc_mark(pi->circ_array->objs[i]);
+	}
+    }
+}
+
+// A document that ends before it is closed is returned with the values
+// completed so far. Open arrays and hashes that collect their children on the
+// value stack still hold an offset so they are built here, innermost first.
+static void
+build_open(ParseInfo pi) {
+    Val	v;
+
+    for (v = pi->stack.tail - 1; pi->stack.head <= v; v--) {
+	if (!FIXNUM_P(v->val)) {
+	    continue;
+	}
+	switch (v->next) {
+	case NEXT_ARRAY_NEW:
+	case NEXT_ARRAY_ELEMENT:
+	case NEXT_ARRAY_COMMA:
+	    v->val = oj_stack_array(&pi->stack, FIX2LONG(v->val));
+	    break;
+	default:
+	    v->val = oj_stack_hash(&pi->stack, FIX2LONG(v->val));
+	    break;
+	}
+    }
+}
+
 VALUE
-oj_pi_parse(int argc, VALUE *argv, ParseInfo pi, char *json) {
-    char	*buf = 0;
+oj_pi_parse(int argc, VALUE *argv, ParseInfo pi, char *json, size_t len) {
     VALUE	input;
+    VALUE	s = Qnil;
     VALUE	result = Qnil;
+    VALUE	guard = Qnil;
+    VALUE	paths;
     int		line = 0;
-    int		free_json = 0;
 
     if (argc < 1) {
 	rb_raise(rb_eArgError, "Wrong number of arguments to parse.");
@@ -717,36 +1200,33 @@ oj_pi_parse(int argc, VALUE *argv, ParseInfo pi, char *json) {
 	oj_parse_options(argv[1], &pi->options);
     }
     pi->cbc = (void*)0;
+    pi->yield_docs = rb_block_given_p();
+    pi->threads = (pi->yield_docs && 2 == argc) ? oj_parse_threads(argv[1]) : 0;
+    oj_tape_init(&pi->tape);
+    arena_init(&pi->arena);
     if (0 != json) {
 	pi->json = json;
-	free_json = 1;
+	pi->end = json + len;
     } else if (rb_type(input) == T_STRING) {
 	pi->json = StringValuePtr(input);
+	pi->end = pi->json + RSTRING_LEN(input);
+	if (2 == argc) {
+	    oj_parse_slice(argv[1], &pi->json, &pi->end);
+	}
     } else {
 	VALUE	clas = rb_obj_class(input);
-	VALUE	s;
 
 	if (oj_stringio_class == clas) {
 	    s = rb_funcall2(input, oj_string_id, 0, 0);
 	    pi->json = StringValuePtr(s);
+	    pi->end = pi->json + RSTRING_LEN(s);
 #ifndef JRUBY_RUBY
 #if !IS_WINDOWS
 	    // JRuby gets confused with what is the real fileno.
 	} else if (rb_respond_to(input, oj_fileno_id) && Qnil != (s = rb_funcall(input, oj_fileno_id, 0))) {
-	    int		fd = FIX2INT(s);
-	    ssize_t	cnt;
-	    size_t	len = lseek(fd, 0, SEEK_END);
-
-	    lseek(fd, 0, SEEK_SET);
-	    buf = ALLOC_N(char, len + 1);
-	    pi->json = buf;
-	    if (0 >= (cnt = read(fd, (char*)pi->json, len)) || cnt != (ssize_t)len) {
-		if (0 != buf) {
-		    xfree(buf);
-		}
-		rb_raise(rb_eIOError, "failed to read from IO Object.");
-	    }
-	    ((char*)pi->json)[len] = '\0';
+	    s = oj_read_fd(FIX2INT(s));
+	    pi->json = RSTRING_PTR(s);
+	    pi->end = pi->json + RSTRING_LEN(s);
 	    /* skip UTF-8 BOM if present */
 	    if (0xEF == (uint8_t)*pi->json && 0xBB == (uint8_t)pi->json[1] && 0xBF == (uint8_t)pi->json[2]) {
 		pi->json += 3;
@@ -756,36 +1236,50 @@ oj_pi_parse(int argc, VALUE *argv, ParseInfo pi, char *json) {
 	} else if (rb_respond_to(input, oj_read_id)) {
 	    s = rb_funcall2(input, oj_read_id, 0, 0);
 	    pi->json = StringValuePtr(s);
+	    pi->end = pi->json + RSTRING_LEN(s);
 	} else {
 	    rb_raise(rb_eArgError, "strict_parse() expected a String or IO Object.");
 	}
     }
+    pi->only = 0;
+    if (2 == argc && Qnil != (paths = oj_parse_only(argv[1]))) {
+	pi->only = oj_only_new(paths);
+    }
     if (Yes == pi->options.circular) {
 	pi->circ_array = oj_circ_array_new();
     } else {
 	pi->circ_array = 0;
     }
-    // GC can run at any time. When it runs any Object created by C will be
-    // freed. This usually only happens with large files but it does happen and
-    // it happens more frequently on Ruby 1.8.7.
+    // GC can run at any time. When it runs any Object created by C and not
+    // yet reachable from Ruby would be freed, so the values held by the
+    // parser are marked through a hidden guard Object instead of turning GC
+    // off for the whole parse.
 #if HAS_GC_GUARD
-    rb_gc_disable();
+    stack_init(&pi->stack);
+    guard = Data_Wrap_Struct(0, oj_parse_mark, 0, pi);
 #endif
     rb_protect(protect_parse, (VALUE)pi, &line);
+    if (0 == line && !stack_empty(&pi->stack)) {
+	build_open(pi);
+    }
     result = stack_head_val(&pi->stack);
+    if (pi->yield_docs && 0 == line && !err_has(&pi->err) && !stack_empty(&pi->stack)) {
+	oj_set_error_at(pi, oj_parse_error_class, __FILE__, __LINE__, "expected %s at the end of the input",
+			oj_stack_next_string(stack_peek(&pi->stack)->next));
+    }
 #if HAS_GC_GUARD
     RB_GC_GUARD(result);
-    rb_gc_enable();
+    RB_GC_GUARD(s);
+    DATA_PTR(guard) = 0;
+    RB_GC_GUARD(guard);
 #endif
     // proceed with cleanup
     if (0 != pi->circ_array) {
 	oj_circ_array_free(pi->circ_array);
     }
-    if (0 != buf) {
-	xfree(buf);
-    } else if (free_json) {
-	xfree(json);
-    }
+    oj_only_free(pi->only);
+    oj_tape_cleanup(&pi->tape);
+    arena_cleanup(&pi->arena);
     stack_cleanup(&pi->stack);
     if (0 != line) {
 	rb_jump_tag(line);
@@ -37,29 +37,28 @@
 #include "oj.h"
 #include "val_stack.h"
 #include "circarray.h"
-
-typedef struct _NumInfo {
-    int64_t	i;
-    int64_t	num;
-    int64_t	div;
-    const char	*str;
-    size_t	len;
-    long	exp;
-    int		dec_cnt;
-    int		big;
-    int		infinity;
-    int		neg;
-} *NumInfo;
+#include "simd.h"
+#include "arena.h"
+#include "only.h"
+#include "num.h"
 
 typedef struct _ParseInfo {
     const char		*json;
+    const char		*end;	// the document ends here or at a '\0'
     const char		*cur;
     struct _Err		err;
     struct _Options	options;
     void		*cbc;
     struct _ValStack	stack;
+    struct _Arena	arena;	// keys and class names copied during the parse
     CircArray		circ_array;
+    Only		only;	// paths to keep with the :only option or 0
+    struct _Tape	tape;
     int			expect_value;
+    int			more;	// more input may follow end
+    int			skipping; // a skipped container was cut off by the end
+    int			yield_docs; // yield each top level value as it completes
+    int			threads; // native threads that index records when yielding
     VALUE		(*start_hash)(struct _ParseInfo *pi);
     void		(*end_hash)(struct _ParseInfo *pi);
     void		(*hash_set_cstr)(struct _ParseInfo *pi, const char *key, size_t klen, const char *str, size_t len, const char *orig);
@@ -78,11 +77,19 @@ typedef struct _ParseInfo {
 } *ParseInfo;
 
 extern void	oj_parse2(ParseInfo pi);
+extern void	oj_parse_tape(ParseInfo pi);
+extern void	oj_parse_chunk(ParseInfo pi);
+extern void	oj_parse_tape_walk(ParseInfo pi, Tape tape);
+extern void	oj_parse_lines(ParseInfo pi);
 extern void	oj_set_error_at(ParseInfo pi, VALUE err_clas, const char* file, int line, const char *format, ...);
-extern VALUE	oj_pi_parse(int argc, VALUE *argv, ParseInfo pi, char *json);
-extern VALUE	oj_num_as_value(NumInfo ni);
+extern VALUE	oj_pi_parse(int argc, VALUE *argv, ParseInfo pi, char *json, size_t len);
+extern void	oj_parse_mark(void *ptr);
+extern int	oj_only_skip(ParseInfo pi);
+extern void	oj_skip_value(ParseInfo pi);
+extern VALUE	oj_cstr_to_value(ParseInfo pi, const char *str, size_t len);
 
 extern void	oj_set_strict_callbacks(ParseInfo pi);
 extern void	oj_set_compat_callbacks(ParseInfo pi);
+extern void	oj_set_sc_callbacks(ParseInfo pi, VALUE handler);
 
 #endif /* __OJ_PARSE_H__ */
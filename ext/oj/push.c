@@ -0,0 +1,435 @@
+/* push.c
+ * Copyright (c) 2013, Peter Ohler
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *  - Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ *  - Neither the name of Peter Ohler nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "oj.h"
+#include "err.h"
+#include "parse.h"
+
+#define BUF_INIT	4096
+
+typedef struct _Parser {
+    struct _ParseInfo	pi;	// first so callbacks can cast back to the Parser
+    char		*buf;	// input not parsed yet, '\0' terminated
+    size_t		len;
+    size_t		size;
+    VALUE		proc;	// called with each document in the load modes
+    VALUE		docs;	// documents finished in the current chunk
+    void		(*add_cstr)(ParseInfo pi, const char *str, size_t len, const char *orig);
+    void		(*add_num)(ParseInfo pi, NumInfo ni);
+    void		(*add_value)(ParseInfo pi, VALUE val);
+} *Parser;
+
+static ID	call_id;
+
+// The load modes leave a finished top level value in the stack head. It is
+// moved to the documents that are handed to the block after the chunk.
+static void
+doc_done(Parser p) {
+    rb_ary_push(p->docs, p->pi.stack.head->val);
+    p->pi.stack.head->val = Qundef;
+}
+
+static void
+add_cstr(ParseInfo pi, const char *str, size_t len, const char *orig) {
+    Parser	p = (Parser)pi;
+
+    p->add_cstr(pi, str, len, orig);
+    doc_done(p);
+}
+
+static void
+add_num(ParseInfo pi, NumInfo ni) {
+    Parser	p = (Parser)pi;
+
+    p->add_num(pi, ni);
+    doc_done(p);
+}
+
+static void
+add_value(ParseInfo pi, VALUE val) {
+    Parser	p = (Parser)pi;
+
+    p->add_value(pi, val);
+    doc_done(p);
+}
+
+static void
+parser_mark(void *ptr) {
+    Parser	p = (Parser)ptr;
+
+    rb_gc_mark(p->proc);
+    rb_gc_mark(p->docs);
+    if (0 != p->pi.cbc) {
+	rb_gc_mark((VALUE)p->pi.cbc);
+    }
+    oj_parse_mark(&p->pi);
+}
+
+static void
+parser_free(void *ptr) {
+    Parser	p = (Parser)ptr;
+
+    arena_cleanup(&p->pi.arena);
+    oj_tape_cleanup(&p->pi.tape);
+    stack_cleanup(&p->pi.stack);
+    xfree(p->buf);
+    xfree(p);
+}
+
+// Keys and class names that point into the buffer are copied to the arena
+// before the buffer is reused. Keys that have already been used are
+// dropped.
+static void
+keep_keys(Parser p) {
+    const char	*start = p->buf;
+    const char	*end = p->buf + p->len;
+    Val		v;
+
+    for (v = p->pi.stack.head; v < p->pi.stack.tail; v++) {
+	if (start <= v->key && v->key <= end) {
+	    if (NEXT_HASH_COLON == v->next || NEXT_HASH_VALUE == v->next) {
+		v->key = arena_strndup(&p->pi.arena, v->key, v->klen);
+	    } else {
+		v->key = 0;
+	    }
+	}
+	if (start <= v->classname && v->classname <= end) {
+	    v->classname = arena_strndup(&p->pi.arena, v->classname, v->clen);
+	}
+    }
+}
+
+static VALUE
+protect_chunk(VALUE pip) {
+    oj_parse_chunk((ParseInfo)pip);
+
+    return Qnil;
+}
+
+// Parses the buffered input. If more is set a token cut off by the end of
+// the buffer is kept for the next chunk.
+static void
+parse_buf(Parser p, int more) {
+    ParseInfo	pi = &p->pi;
+    const char	*end = p->buf + p->len;
+    size_t	used;
+    int		line = 0;
+
+    pi->json = p->buf;
+    pi->end = end;
+    pi->more = more;
+    rb_protect(protect_chunk, (VALUE)pi, &line);
+    if (stack_empty(&pi->stack)) {
+	// nothing pending so nothing in the arena is referenced
+	arena_reset(&pi->arena);
+    } else {
+	keep_keys(p);
+    }
+    if (0 != line) {
+	oj_err_set(&pi->err, oj_parse_error_class, "parse stopped by an exception in a callback");
+	rb_jump_tag(line);
+    }
+    if (!err_has(&pi->err) && pi->end == end && pi->cur < end) {
+	// Only a '\0' stops the parse before the end without pausing.
+	pi->cur++;
+	oj_set_error_at(pi, oj_parse_error_class, __FILE__, __LINE__, "unexpected character");
+    }
+    if (err_has(&pi->err)) {
+	oj_err_raise(&pi->err);
+    }
+    used = pi->cur - p->buf;
+    memmove(p->buf, pi->cur, p->len - used);
+    p->len -= used;
+    p->buf[p->len] = '\0';
+}
+
+// Without a handler documents from a stream are passed to the block.
+static void
+check_stream(Parser p) {
+    if (0 != p->add_cstr && Qnil == p->proc) {
+	rb_raise(rb_eArgError, "Oj::Parser needs a block given to new to parse a stream.");
+    }
+}
+
+static void
+yield_docs(Parser p) {
+    VALUE	docs = p->docs;
+    long	cnt = RARRAY_LEN(docs);
+    long	i;
+
+    if (0 < cnt) {
+	p->docs = rb_ary_new();
+	for (i = 0; i < cnt; i++) {
+	    rb_funcall(p->proc, call_id, 1, rb_ary_entry(docs, i));
+	}
+    }
+}
+
+/* call-seq: new(handler=nil, options={}) { |doc| ... } => Oj::Parser
+ *
+ * Creates a parser that is given a JSON stream a chunk at a time or whole
+ * documents with parse(). With a handler the Oj::ScHandler callbacks are
+ * called as in Oj.sc_parse(). Otherwise each top level document is built in
+ * the :strict or :compat mode and passed to the block as soon as it is
+ * closed. The block is only needed for streams. The mode defaults to
+ * :strict.
+ *
+ * @param [Oj::ScHandler] handler responds to the Oj::ScHandler methods
+ * @param [Hash] options parse options (same as default_options)
+ */
+static VALUE
+parser_new(int argc, VALUE *argv, VALUE clas) {
+    Parser	p = ALLOC(struct _Parser);
+    ParseInfo	pi = &p->pi;
+    VALUE	handler = Qnil;
+    VALUE	self;
+
+    memset(p, 0, sizeof(struct _Parser));
+    p->proc = Qnil;
+    p->docs = Qnil;
+    p->size = BUF_INIT;
+    p->buf = ALLOC_N(char, p->size);
+    *p->buf = '\0';
+    pi->options = oj_default_options;
+    pi->options.mode = StrictMode;
+    pi->circ_array = 0;
+    pi->only = 0;
+    err_init(&pi->err);
+    stack_init(&pi->stack);
+    arena_init(&pi->arena);
+    self = Data_Wrap_Struct(clas, parser_mark, parser_free, p);
+    p->docs = rb_ary_new();
+
+    if (0 < argc && rb_cHash != rb_obj_class(*argv) && oj_options_class != rb_obj_class(*argv)) {
+	handler = *argv;
+	argc--;
+	argv++;
+    }
+    if (1 == argc) {
+	oj_parse_options(*argv, &pi->options);
+    } else if (1 < argc) {
+	rb_raise(rb_eArgError, "Wrong number of arguments to Oj::Parser.new.");
+    }
+    if (Qnil != handler) {
+	oj_set_sc_callbacks(pi, handler);
+	return self;
+    }
+    switch (pi->options.mode) {
+    case StrictMode:
+	oj_set_strict_callbacks(pi);
+	break;
+    case NullMode:
+    case CompatMode:
+	oj_set_compat_callbacks(pi);
+	break;
+    default:
+	rb_raise(rb_eArgError, "Oj::Parser only supports the :strict and :compat modes.");
+	break;
+    }
+    if (rb_block_given_p()) {
+	p->proc = rb_block_proc();
+    }
+    p->add_cstr = pi->add_cstr;
+    p->add_num = pi->add_num;
+    p->add_value = pi->add_value;
+    pi->add_cstr = add_cstr;
+    pi->add_num = add_num;
+    pi->add_value = add_value;
+
+    return self;
+}
+
+/* call-seq: <<(chunk) => self
+ *
+ * Parses the next chunk of the stream. A token cut off by the end of the
+ * chunk is finished with the next one. Documents closed in the chunk are
+ * passed to the block before returning.
+ *
+ * @param [String] chunk next part of the JSON stream
+ */
+static VALUE
+parser_push(VALUE self, VALUE chunk) {
+    Parser	p = DATA_PTR(self);
+    size_t	len;
+
+    if (err_has(&p->pi.err)) {
+	oj_err_raise(&p->pi.err);
+    }
+    check_stream(p);
+    Check_Type(chunk, T_STRING);
+    len = RSTRING_LEN(chunk);
+    if (p->size <= p->len + len) {
+	p->size = (p->len + len) * 2;
+	REALLOC_N(p->buf, char, p->size);
+    }
+    memcpy(p->buf + p->len, StringValuePtr(chunk), len);
+    p->len += len;
+    p->buf[p->len] = '\0';
+    parse_buf(p, 1);
+    yield_docs(p);
+
+    return self;
+}
+
+/* call-seq: finish() => self
+ *
+ * Marks the end of the stream. A number at the very end is parsed and an
+ * error is raised if a document was not closed. The parser can then be used
+ * for a new stream.
+ */
+static VALUE
+parser_finish(VALUE self) {
+    Parser	p = DATA_PTR(self);
+    ParseInfo	pi = &p->pi;
+
+    if (err_has(&pi->err)) {
+	oj_err_raise(&pi->err);
+    }
+    check_stream(p);
+    parse_buf(p, 0);
+    if (!stack_empty(&pi->stack)) {
+	oj_err_set(&pi->err, oj_parse_error_class, "expected %s at the end of the input",
+		   oj_stack_next_string(stack_peek(&pi->stack)->next));
+	oj_err_raise(&pi->err);
+    }
+    yield_docs(p);
+    stack_reset(&pi->stack);
+    arena_reset(&pi->arena);
+
+    return self;
+}
+
+static VALUE
+protect_parse(VALUE pip) {
+    ParseInfo	pi = (ParseInfo)pip;
+    size_t	len = pi->end - pi->json;
+
+    if (Yes == pi->options.tape && len < (size_t)UINT32_MAX) {
+	oj_tape_start(&pi->tape, pi->json, len);
+	oj_parse_tape_walk(pi, &pi->tape);
+    } else {
+	oj_parse_chunk(pi);
+    }
+    return Qnil;
+}
+
+/* call-seq: parse(json) => Object
+ *
+ * Parses a complete document with the options given to new() and returns
+ * it, or nil with a handler. The stack, tape, and options of the parser are
+ * reused so a parser kept around for many small documents avoids most of
+ * the setup Oj.load() goes through on each call. It can not be called while
+ * a stream is only partly parsed.
+ *
+ * @param [String] json JSON document to parse
+ */
+static VALUE
+parser_parse(VALUE self, VALUE json) {
+    Parser	p = DATA_PTR(self);
+    ParseInfo	pi = &p->pi;
+    struct _Err	err;
+    VALUE	result;
+    int		line = 0;
+
+    Check_Type(json, T_STRING);
+    if (0 < p->len || !stack_empty(&pi->stack)) {
+	rb_raise(rb_eArgError, "Oj::Parser#parse can not be called in the middle of a stream.");
+    }
+    if (0 != p->add_cstr) {
+	pi->add_cstr = p->add_cstr;
+	pi->add_num = p->add_num;
+	pi->add_value = p->add_value;
+    }
+    pi->json = RSTRING_PTR(json);
+    pi->end = pi->json + RSTRING_LEN(json);
+    pi->more = 0;
+    err_init(&pi->err);
+    rb_protect(protect_parse, (VALUE)pi, &line);
+    RB_GC_GUARD(json);
+    result = stack_head_val(&pi->stack);
+    if (0 == line && !err_has(&pi->err) && !stack_empty(&pi->stack)) {
+	oj_set_error_at(pi, oj_parse_error_class, __FILE__, __LINE__, "expected %s at the end of the input",
+			oj_stack_next_string(stack_peek(&pi->stack)->next));
+    }
+    if (0 != p->add_cstr) {
+	pi->add_cstr = add_cstr;
+	pi->add_num = add_num;
+	pi->add_value = add_value;
+    }
+    // leave the parser ready for the next document or stream
+    stack_reset(&pi->stack);
+    arena_reset(&pi->arena);
+    err = pi->err;
+    err_init(&pi->err);
+    if (0 != line) {
+	rb_jump_tag(line);
+    }
+    if (err_has(&err)) {
+	oj_err_raise(&err);
+    }
+    return result;
+}
+
+/* Document-class: Oj::Parser
+ *
+ * A push parser for JSON that arrives in pieces, such as from a socket. Each
+ * chunk is parsed as it is added and only a token cut off by the end of a
+ * chunk is held until the next one.
+ *
+ * @example
+ *   parser = Oj::Parser.new(:mode => :strict) { |doc| p doc }
+ *   parser << '{"a":[1,2'
+ *   parser << '3]} {"b":'
+ *   parser << 'true}'
+ *   parser.finish
+ *   #=> {"a"=>[1, 23]}
+ *   #=> {"b"=>true}
+ *
+ * A parser can also be kept to parse many complete documents.
+ *
+ * @example
+ *   parser = Oj::Parser.new(:mode => :compat, :symbol_keys => true)
+ *   parser.parse('{"a":1}')
+ *   #=> {:a=>1}
+ */
+void
+oj_init_parser() {
+    VALUE	parser_class = rb_define_class_under(Oj, "Parser", rb_cObject);
+
+    rb_undef_alloc_func(parser_class);
+    rb_define_singleton_method(parser_class, "new", parser_new, -1);
+    rb_define_method(parser_class, "<<", parser_push, 1);
+    rb_define_method(parser_class, "finish", parser_finish, 0);
+    rb_define_method(parser_class, "parse", parser_parse, 1);
+    call_id = rb_intern("call");
+}
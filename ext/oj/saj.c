@@ -43,6 +43,9 @@
 
 #include "oj.h"
 #include "encode.h"
+#include "simd.h"
+#include "num.h"
+#include "mapped_file.h"
 
 typedef struct _CX {
     VALUE	*cur;
@@ -109,20 +112,15 @@ call_error(const char *msg, ParseInfo pi, const char* file, int line) {
 
 inline static void
 next_non_white(ParseInfo pi) {
-    for (; 1; pi->s++) {
-	switch(*pi->s) {
-	case ' ':
-	case '\t':
-	case '\f':
-	case '\n':
-	case '\r':
-	    break;
-	case '/':
-	    skip_comment(pi);
-	    break;
-	default:
+    while (1) {
+	pi->s = (char*)oj_skip_white(pi->s);
+	if ('/' != *pi->s) {
 	    return;
 	}
+	skip_comment(pi);
+	if ('\0' != *pi->s) {
+	    pi->s++;
+	}
     }
 }
 
@@ -156,7 +154,7 @@ call_add_value(VALUE handler, VALUE value, const char *key) {
     rb_funcall(handler, oj_add_value_id, 2, value, k);
 }
 
-inline static void
+inline static VALUE
 call_no_value(VALUE handler, ID method, const char *key) {
     VALUE	k;
 
@@ -166,7 +164,25 @@ call_no_value(VALUE handler, ID method, const char *key) {
 	k = rb_str_new2(key);
 	k = oj_encode(k);
     }
-    rb_funcall(handler, method, 1, k);
+    return rb_funcall(handler, method, 1, k);
+}
+
+// Called when a start callback returns Oj::SKIP. Moves past the Hash or Array
+// at pi->s without any more callbacks, including the end callback.
+static void
+skip_container(ParseInfo pi) {
+    const char	*s = oj_skip_container(pi->s);
+
+    if (0 == s) {
+	pi->s += strlen(pi->s);
+	if (pi->has_error) {
+	    call_error("value not terminated", pi, __FILE__, __LINE__);
+	} else {
+	    raise_error("value not terminated", pi->str, pi->s);
+	}
+	return;
+    }
+    pi->s = (char*)s;
 }
 
 static void
@@ -262,8 +278,9 @@ static void
 read_hash(ParseInfo pi, const char *key) {
     const char	*ks;
     
-    if (pi->has_hash_start) {
-	call_no_value(pi->handler, oj_hash_start_id, key);
+    if (pi->has_hash_start && oj_skip_obj == call_no_value(pi->handler, oj_hash_start_id, key)) {
+	skip_container(pi);
+	return;
     }
     pi->s++;
     next_non_white(pi);
@@ -304,8 +321,9 @@ read_hash(ParseInfo pi, const char *key) {
 
 static void
 read_array(ParseInfo pi, const char *key) {
-    if (pi->has_array_start) {
-	call_no_value(pi->handler, oj_array_start_id, key);
+    if (pi->has_array_start && oj_skip_obj == call_no_value(pi->handler, oj_array_start_id, key)) {
+	skip_container(pi);
+	return;
     }
     pi->s++;
     next_non_white(pi);
@@ -451,21 +469,12 @@ read_num(ParseInfo pi, const char *key) {
 	    }
 	    *pi->s = c;
 	} else {
-	    double	d = (double)n + (double)a / (double)div;
-
-	    if (neg) {
-		d = -d;
-	    }
-	    if (1 < big) {
-		e += big - 1;
-	    }
-	    if (0 != e) {
-		if (eneg) {
-		    e = -e;
-		}
-		d *= pow(10.0, e);
+	    if (eneg) {
+		e = -e;
 	    }
 	    if (pi->has_add_value) {
+		double	d = oj_num_to_double(neg, n, a, div, e, start, pi->s - start);
+
 		call_add_value(pi->handler, rb_float_new(d), key);
 	    }
 	}
@@ -593,6 +602,8 @@ read_quoted_value(ParseInfo pi) {
     h++;	/* skip quote character */
     t++;
     value = h;
+    h = (char*)oj_scan_string(h); /* skip the leading plain run in one step */
+    t = h;
     for (; '"' != *h; h++, t++) {
 	if ('\0' == *h) {
 	    pi->s = h;
@@ -640,8 +651,12 @@ read_quoted_value(ParseInfo pi) {
 		raise_error("invalid escaped character", pi->str, pi->s);
 		break;
 	    }
-	} else if (t != h) {
-	    *t = *h;
+	} else {
+	    char	*e = (char*)oj_scan_string(h);
+
+	    memmove(t, h, e - h);
+	    t += e - h - 1;
+	    h = e - 1;
 	}
     }
     *t = '\0'; /* terminate value */
@@ -749,16 +764,10 @@ oj_saj_parse(int argc, VALUE *argv, VALUE self) {
 #if !IS_WINDOWS
 	    // JRuby gets confused with what is the real fileno.
 	} else if (rb_respond_to(input, oj_fileno_id) && Qnil != (s = rb_funcall(input, oj_fileno_id, 0))) {
-	    int		fd = FIX2INT(s);
-	    ssize_t	cnt;
-
-	    len = lseek(fd, 0, SEEK_END);
-	    lseek(fd, 0, SEEK_SET);
-	    json = ALLOC_N(char, len + 1);
-	    if (0 >= (cnt = read(fd, json, len)) || cnt != (ssize_t)len) {
-		rb_raise(rb_eIOError, "failed to read from IO Object.");
-	    }
-	    json[len] = '\0';
+	    s = oj_read_fd(FIX2INT(s));
+	    len = RSTRING_LEN(s) + 1;
+	    json = ALLOC_N(char, len);
+	    memcpy(json, RSTRING_PTR(s), len);
 #endif
 #endif
 	} else if (rb_respond_to(input, oj_read_id)) {
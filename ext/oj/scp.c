@@ -37,7 +37,9 @@
 
 #include "oj.h"
 #include "parse.h"
+#include "hash.h"
 #include "encode.h"
+#include "mapped_file.h"
 
 inline static int
 respond_to(VALUE obj, ID method) {
@@ -140,13 +142,13 @@ end_array(ParseInfo pi) {
 
 static VALUE
 hash_key(ParseInfo pi, const char *key, size_t klen) {
-    VALUE	rkey = rb_str_new(key, klen);
-
-    rkey = oj_encode(rkey);
     if (Yes == pi->options.sym_key) {
-	rkey = rb_str_intern(rkey);
+	return oj_sym_cache_get(key, klen);
+    }
+    if (Yes == pi->options.cache_keys) {
+	return oj_key_cache_get(key, klen);
     }
-    return rkey;
+    return oj_encode(rb_str_new(key, klen));
 }
 
 static void
@@ -187,17 +189,66 @@ array_append_value(ParseInfo pi, VALUE value) {
 
 static VALUE
 protect_parse(VALUE pip) {
-    oj_parse2((ParseInfo)pip);
+    ParseInfo	pi = (ParseInfo)pip;
+
+    if (Yes == pi->options.tape) {
+	oj_parse_tape(pi);
+    } else {
+	oj_parse2(pi);
+    }
 
     return Qnil;
 }
 
+void
+oj_set_sc_callbacks(ParseInfo pi, VALUE handler) {
+    pi->cbc = (void*)handler;
+    pi->start_hash = respond_to(handler, oj_hash_start_id) ? start_hash : noop_start;
+    pi->end_hash = respond_to(handler, oj_hash_end_id) ? end_hash : noop_end;
+    pi->start_array = respond_to(handler, oj_array_start_id) ? start_array : noop_start;
+    pi->end_array = respond_to(handler, oj_array_end_id) ? end_array : noop_end;
+    if (respond_to(handler, oj_hash_set_id)) {
+	pi->hash_set_value = hash_set_value;
+	pi->hash_set_cstr = hash_set_cstr;
+	pi->hash_set_num = hash_set_num;
+	pi->expect_value = 1;
+    } else {
+	pi->hash_set_value = noop_hash_set_value;
+	pi->hash_set_cstr = noop_hash_set_cstr;
+	pi->hash_set_num = noop_hash_set_num;
+	pi->expect_value = 0;
+    }
+    if (respond_to(handler, oj_array_append_id)) {
+	pi->array_append_value = array_append_value;
+	pi->array_append_cstr = array_append_cstr;
+	pi->array_append_num = array_append_num;
+	pi->expect_value = 1;
+    } else {
+	pi->array_append_value = noop_array_append_value;
+	pi->array_append_cstr = noop_array_append_cstr;
+	pi->array_append_num = noop_array_append_num;
+	pi->expect_value = 0;
+    }
+    if (respond_to(handler, oj_add_value_id)) {
+	pi->add_cstr = add_cstr;
+	pi->add_num = add_num;
+	pi->add_value = add_value;
+	pi->expect_value = 1;
+    } else {
+	pi->add_cstr = noop_add_cstr;
+	pi->add_num = noop_add_num;
+	pi->add_value = noop_add_value;
+	pi->expect_value = 0;
+    }
+}
+
 VALUE
 oj_sc_parse(int argc, VALUE *argv, VALUE self) {
     struct _ParseInfo	pi;
-    char		*buf = 0;
     VALUE		input;
+    VALUE		s = Qnil;
     VALUE		handler;
+    VALUE		guard = Qnil;
     int			line = 0;
 
     if (argc < 2) {
@@ -206,90 +257,61 @@ oj_sc_parse(int argc, VALUE *argv, VALUE self) {
     handler = *argv;;
     input = argv[1];
     pi.json = 0;
+    pi.yield_docs = 0;
     pi.options = oj_default_options;
     if (3 == argc) {
 	oj_parse_options(argv[2], &pi.options);
     }
-    pi.cbc = (void*)handler;
+    oj_tape_init(&pi.tape);
+    arena_init(&pi.arena);
+    oj_set_sc_callbacks(&pi, handler);
 
-    pi.start_hash = respond_to(handler, oj_hash_start_id) ? start_hash : noop_start;
-    pi.end_hash = respond_to(handler, oj_hash_end_id) ? end_hash : noop_end;
-    pi.start_array = respond_to(handler, oj_array_start_id) ? start_array : noop_start;
-    pi.end_array = respond_to(handler, oj_array_end_id) ? end_array : noop_end;
-    if (respond_to(handler, oj_hash_set_id)) {
-	pi.hash_set_value = hash_set_value;
-	pi.hash_set_cstr = hash_set_cstr;
-	pi.hash_set_num = hash_set_num;
-	pi.expect_value = 1;
-    } else {
-	pi.hash_set_value = noop_hash_set_value;
-	pi.hash_set_cstr = noop_hash_set_cstr;
-	pi.hash_set_num = noop_hash_set_num;
-	pi.expect_value = 0;
-    }
-    if (respond_to(handler, oj_array_append_id)) {
-	pi.array_append_value = array_append_value;
-	pi.array_append_cstr = array_append_cstr;
-	pi.array_append_num = array_append_num;
-	pi.expect_value = 1;
-    } else {
-	pi.array_append_value = noop_array_append_value;
-	pi.array_append_cstr = noop_array_append_cstr;
-	pi.array_append_num = noop_array_append_num;
-	pi.expect_value = 0;
-    }
-    if (respond_to(handler, oj_add_value_id)) {
-	pi.add_cstr = add_cstr;
-	pi.add_num = add_num;
-	pi.add_value = add_value;
-	pi.expect_value = 1;
-    } else {
-	pi.add_cstr = noop_add_cstr;
-	pi.add_num = noop_add_num;
-	pi.add_value = noop_add_value;
-	pi.expect_value = 0;
-    }
     if (rb_type(input) == T_STRING) {
 	pi.json = StringValuePtr(input);
+	pi.end = pi.json + RSTRING_LEN(input);
+	if (3 == argc) {
+	    oj_parse_slice(argv[2], &pi.json, &pi.end);
+	}
     } else {
 	VALUE	clas = rb_obj_class(input);
-	VALUE	s;
 
 	if (oj_stringio_class == clas) {
 	    s = rb_funcall2(input, oj_string_id, 0, 0);
-	    pi.json = StringValuePtr(input);
+	    pi.json = StringValuePtr(s);
+	    pi.end = pi.json + RSTRING_LEN(s);
 #ifndef JRUBY_RUBY
 #if !IS_WINDOWS
 	    // JRuby gets confused with what is the real fileno.
 	} else if (rb_respond_to(input, oj_fileno_id) && Qnil != (s = rb_funcall(input, oj_fileno_id, 0))) {
-	    int		fd = FIX2INT(s);
-	    ssize_t	cnt;
-	    size_t	len = lseek(fd, 0, SEEK_END);
-
-	    lseek(fd, 0, SEEK_SET);
-	    buf = ALLOC_N(char, len + 1);
-	    pi.json = buf;
-	    if (0 >= (cnt = read(fd, (char*)pi.json, len)) || cnt != (ssize_t)len) {
-		if (0 != buf) {
-		    xfree(buf);
-		}
-		rb_raise(rb_eIOError, "failed to read from IO Object.");
-	    }
-	    ((char*)pi.json)[len] = '\0';
+	    s = oj_read_fd(FIX2INT(s));
+	    pi.json = RSTRING_PTR(s);
+	    pi.end = pi.json + RSTRING_LEN(s);
 #endif
 #endif
 	} else if (rb_respond_to(input, oj_read_id)) {
 	    s = rb_funcall2(input, oj_read_id, 0, 0);
 	    pi.json = StringValuePtr(s);
+	    pi.end = pi.json + RSTRING_LEN(s);
 	} else {
 	    rb_raise(rb_eArgError, "saj_parse() expected a String or IO Object.");
 	}
     }
+    pi.circ_array = 0;
+    pi.only = 0;
+    // values returned by the handler are held on the stack until they are
+    // passed back to it so the stack is marked
+#if HAS_GC_GUARD
+    stack_init(&pi.stack);
+    guard = Data_Wrap_Struct(0, oj_parse_mark, 0, &pi);
+#endif
     rb_protect(protect_parse, (VALUE)&pi, &line);
-    //oj_parse2(&pi);
-    if (0 != buf) {
-	xfree(buf);
-    }
+#if HAS_GC_GUARD
+    DATA_PTR(guard) = 0;
+    RB_GC_GUARD(guard);
+#endif
+    RB_GC_GUARD(s);
+    oj_tape_cleanup(&pi.tape);
+    arena_cleanup(&pi.arena);
     stack_cleanup(&pi.stack);
     if (0 != line) {
 	rb_jump_tag(line);
@@ -0,0 +1,752 @@
+/* simd.c
+ * Copyright (c) 2013, Peter Ohler
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *  - Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ *  - Neither the name of Peter Ohler nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "ruby.h"
+#include "simd.h"
+
+#ifdef __SSE2__
+#define OJ_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// The AVX2 kernels are compiled with a target attribute so the rest of the
+// extension does not require AVX2. They are only used if the CPU reports
+// support at load time.
+#if defined(OJ_SSE2) && defined(__GNUC__) && (4 < __GNUC__ || (4 == __GNUC__ && 9 <= __GNUC_MINOR__) || defined(__clang__))
+#define OJ_AVX2 1
+#include <immintrin.h>
+#define AVX2_FUNC __attribute__((target("avx2")))
+#endif
+
+#if defined(__GNUC__)
+#define CTZ(x) __builtin_ctz(x)
+#define CTZ64(x) __builtin_ctzll(x)
+#else
+static int
+CTZ(uint32_t x) {
+    int	n = 0;
+
+    for (; 0 == (x & 1); x >>= 1) {
+	n++;
+    }
+    return n;
+}
+
+static int
+CTZ64(uint64_t x) {
+    int	n = 0;
+
+    for (; 0 == (x & 1); x >>= 1) {
+	n++;
+    }
+    return n;
+}
+#endif
+
+// Character classes for one 64 byte block, one bit per byte.
+typedef struct _Block {
+    uint64_t	quote;
+    uint64_t	bslash;
+    uint64_t	white;
+    uint64_t	op;	// {}[]:,
+    uint64_t	slash;
+} *Block;
+
+// Entries in one tape window.
+#define TAPE_WINDOW	4096
+
+static void	(*classify_block)(const char *s, Block b) = 0;
+
+const char*	(*oj_skip_white_run)(const char *s) = 0;
+const char*	(*oj_scan_string)(const char *s) = 0;
+const char*	(*oj_scan_nest)(const char *s) = 0;
+const char*	(*oj_scan_escape)(const char *s, const char *end) = 0;
+const char*	(*oj_scan_escape_ascii)(const char *s, const char *end) = 0;
+
+static const char*
+skip_white_scalar(const char *s) {
+    for (; is_white(*s); s++) {
+    }
+    return s;
+}
+
+static const char*
+scan_string_scalar(const char *s) {
+    for (; '"' != *s && '\\' != *s && '\0' != *s; s++) {
+    }
+    return s;
+}
+
+static const char*
+scan_nest_scalar(const char *s) {
+    for (; 1; s++) {
+	switch (*s) {
+	case '"':
+	case '{':
+	case '}':
+	case '[':
+	case ']':
+	case '/':
+	case '\0':
+	    return s;
+	default:
+	    break;
+	}
+    }
+}
+
+static const char*
+scan_escape_scalar(const char *s, const char *end) {
+    for (; s < end && 0x20 <= (uint8_t)*s && '"' != *s && '\\' != *s; s++) {
+    }
+    return s;
+}
+
+static const char*
+scan_escape_ascii_scalar(const char *s, const char *end) {
+    for (; s < end && 0x20 <= (uint8_t)*s && (uint8_t)*s < 0x7F && '"' != *s && '\\' != *s && '/' != *s; s++) {
+    }
+    return s;
+}
+
+static void
+classify_scalar(const char *s, Block b) {
+    uint64_t	bit = 1;
+
+    memset(b, 0, sizeof(struct _Block));
+    for (; 0 != bit; bit <<= 1, s++) {
+	switch (*s) {
+	case '"':	b->quote |= bit;	break;
+	case '\\':	b->bslash |= bit;	break;
+	case '/':	b->slash |= bit;	break;
+	case ' ':
+	case '\t':
+	case '\f':
+	case '\n':
+	case '\r':	b->white |= bit;	break;
+	case '{':
+	case '}':
+	case '[':
+	case ']':
+	case ':':
+	case ',':	b->op |= bit;		break;
+	default:				break;
+	}
+    }
+}
+
+// The vector versions load aligned blocks only. An aligned load never crosses
+// a page boundary so reading the bytes past the '\0' terminator in the same
+// block is safe even at the very end of an allocation.
+
+#ifdef OJ_SSE2
+inline static uint32_t
+white_mask16(__m128i v) {
+    __m128i	w = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+				 _mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+
+    w = _mm_or_si128(w, _mm_cmpeq_epi8(v, _mm_set1_epi8('\t')));
+    w = _mm_or_si128(w, _mm_cmpeq_epi8(v, _mm_set1_epi8('\r')));
+    w = _mm_or_si128(w, _mm_cmpeq_epi8(v, _mm_set1_epi8('\f')));
+
+    return (uint32_t)_mm_movemask_epi8(w);
+}
+
+static const char*
+skip_white_sse2(const char *s) {
+    uintptr_t	off = (uintptr_t)s & 0x0F;
+    const char	*b = s - off;
+    uint32_t	m = ~white_mask16(_mm_load_si128((const __m128i*)b)) & (0x0000FFFF << off);
+
+    while (0 == m) {
+	b += 16;
+	m = ~white_mask16(_mm_load_si128((const __m128i*)b)) & 0x0000FFFF;
+    }
+    return b + CTZ(m);
+}
+
+inline static uint32_t
+str_mask16(__m128i v) {
+    __m128i	m = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')),
+				 _mm_cmpeq_epi8(v, _mm_set1_epi8('\\')));
+
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_setzero_si128()));
+
+    return (uint32_t)_mm_movemask_epi8(m);
+}
+
+static const char*
+scan_string_sse2(const char *s) {
+    uintptr_t	off = (uintptr_t)s & 0x0F;
+    const char	*b = s - off;
+    uint32_t	m = str_mask16(_mm_load_si128((const __m128i*)b)) & (0x0000FFFF << off);
+
+    while (0 == m) {
+	b += 16;
+	m = str_mask16(_mm_load_si128((const __m128i*)b));
+    }
+    return b + CTZ(m);
+}
+
+// '[' and ']' differ from '{' and '}' only in the 0x20 bit so two compares
+// cover all four brackets.
+inline static uint32_t
+nest_mask16(__m128i v) {
+    __m128i	l = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    __m128i	m = _mm_or_si128(_mm_cmpeq_epi8(l, _mm_set1_epi8('{')),
+				 _mm_cmpeq_epi8(l, _mm_set1_epi8('}')));
+
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('"')));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('/')));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_setzero_si128()));
+
+    return (uint32_t)_mm_movemask_epi8(m);
+}
+
+static const char*
+scan_nest_sse2(const char *s) {
+    uintptr_t	off = (uintptr_t)s & 0x0F;
+    const char	*b = s - off;
+    uint32_t	m = nest_mask16(_mm_load_si128((const __m128i*)b)) & (0x0000FFFF << off);
+
+    while (0 == m) {
+	b += 16;
+	m = nest_mask16(_mm_load_si128((const __m128i*)b));
+    }
+    return b + CTZ(m);
+}
+
+// Control characters are found with an unsigned min, there is no unsigned
+// compare in SSE2.
+inline static uint32_t
+esc_mask16(__m128i v) {
+    __m128i	m = _mm_cmpeq_epi8(_mm_min_epu8(v, _mm_set1_epi8(0x1F)), v);
+
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('"')));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('\\')));
+
+    return (uint32_t)_mm_movemask_epi8(m);
+}
+
+inline static uint32_t
+esc_ascii_mask16(__m128i v) {
+    __m128i	m = _mm_cmpeq_epi8(_mm_max_epu8(v, _mm_set1_epi8(0x7F)), v);
+
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('/')));
+
+    return esc_mask16(v) | (uint32_t)_mm_movemask_epi8(m);
+}
+
+static const char*
+scan_escape_sse2(const char *s, const char *end) {
+    uintptr_t	off = (uintptr_t)s & 0x0F;
+    const char	*b = s - off;
+    uint32_t	m = esc_mask16(_mm_load_si128((const __m128i*)b)) & (0x0000FFFF << off);
+
+    while (0 == m) {
+	b += 16;
+	if (end <= b) {
+	    return end;
+	}
+	m = esc_mask16(_mm_load_si128((const __m128i*)b));
+    }
+    b += CTZ(m);
+
+    return (b < end) ? b : end;
+}
+
+static const char*
+scan_escape_ascii_sse2(const char *s, const char *end) {
+    uintptr_t	off = (uintptr_t)s & 0x0F;
+    const char	*b = s - off;
+    uint32_t	m = esc_ascii_mask16(_mm_load_si128((const __m128i*)b)) & (0x0000FFFF << off);
+
+    while (0 == m) {
+	b += 16;
+	if (end <= b) {
+	    return end;
+	}
+	m = esc_ascii_mask16(_mm_load_si128((const __m128i*)b));
+    }
+    b += CTZ(m);
+
+    return (b < end) ? b : end;
+}
+
+inline static uint32_t
+op_mask16(__m128i v) {
+    __m128i	l = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    __m128i	m = _mm_or_si128(_mm_cmpeq_epi8(l, _mm_set1_epi8('{')),
+				 _mm_cmpeq_epi8(l, _mm_set1_epi8('}')));
+
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8(':')));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8(',')));
+
+    return (uint32_t)_mm_movemask_epi8(m);
+}
+
+static void
+classify_sse2(const char *s, Block b) {
+    uint64_t	quote = 0;
+    uint64_t	bslash = 0;
+    uint64_t	slash = 0;
+    uint64_t	white = 0;
+    uint64_t	op = 0;
+    int		i;
+
+    for (i = 0; i < 64; i += 16) {
+	__m128i	v = _mm_loadu_si128((const __m128i*)(s + i));
+
+	quote |= (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('"'))) << i;
+	bslash |= (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))) << i;
+	slash |= (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('/'))) << i;
+	white |= (uint64_t)white_mask16(v) << i;
+	op |= (uint64_t)op_mask16(v) << i;
+    }
+    b->quote = quote;
+    b->bslash = bslash;
+    b->slash = slash;
+    b->white = white;
+    b->op = op;
+}
+#endif
+
+#ifdef OJ_AVX2
+AVX2_FUNC inline static uint32_t
+white_mask32(__m256i v) {
+    __m256i	w = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+				    _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')));
+
+    w = _mm256_or_si256(w, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t')));
+    w = _mm256_or_si256(w, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')));
+    w = _mm256_or_si256(w, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\f')));
+
+    return (uint32_t)_mm256_movemask_epi8(w);
+}
+
+AVX2_FUNC static const char*
+skip_white_avx2(const char *s) {
+    uintptr_t	off = (uintptr_t)s & 0x1F;
+    const char	*b = s - off;
+    uint32_t	m = ~white_mask32(_mm256_load_si256((const __m256i*)b)) & (0xFFFFFFFF << off);
+
+    while (0 == m) {
+	b += 32;
+	m = ~white_mask32(_mm256_load_si256((const __m256i*)b));
+    }
+    return b + CTZ(m);
+}
+
+AVX2_FUNC inline static uint32_t
+str_mask32(__m256i v) {
+    __m256i	m = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')),
+				    _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\')));
+
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_setzero_si256()));
+
+    return (uint32_t)_mm256_movemask_epi8(m);
+}
+
+AVX2_FUNC static const char*
+scan_string_avx2(const char *s) {
+    uintptr_t	off = (uintptr_t)s & 0x1F;
+    const char	*b = s - off;
+    uint32_t	m = str_mask32(_mm256_load_si256((const __m256i*)b)) & (0xFFFFFFFF << off);
+
+    while (0 == m) {
+	b += 32;
+	m = str_mask32(_mm256_load_si256((const __m256i*)b));
+    }
+    return b + CTZ(m);
+}
+
+AVX2_FUNC inline static uint32_t
+nest_mask32(__m256i v) {
+    __m256i	l = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+    __m256i	m = _mm256_or_si256(_mm256_cmpeq_epi8(l, _mm256_set1_epi8('{')),
+				    _mm256_cmpeq_epi8(l, _mm256_set1_epi8('}')));
+
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')));
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('/')));
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_setzero_si256()));
+
+    return (uint32_t)_mm256_movemask_epi8(m);
+}
+
+AVX2_FUNC static const char*
+scan_nest_avx2(const char *s) {
+    uintptr_t	off = (uintptr_t)s & 0x1F;
+    const char	*b = s - off;
+    uint32_t	m = nest_mask32(_mm256_load_si256((const __m256i*)b)) & (0xFFFFFFFF << off);
+
+    while (0 == m) {
+	b += 32;
+	m = nest_mask32(_mm256_load_si256((const __m256i*)b));
+    }
+    return b + CTZ(m);
+}
+
+AVX2_FUNC inline static uint32_t
+esc_mask32(__m256i v) {
+    __m256i	m = _mm256_cmpeq_epi8(_mm256_min_epu8(v, _mm256_set1_epi8(0x1F)), v);
+
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')));
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\')));
+
+    return (uint32_t)_mm256_movemask_epi8(m);
+}
+
+AVX2_FUNC inline static uint32_t
+esc_ascii_mask32(__m256i v) {
+    __m256i	m = _mm256_cmpeq_epi8(_mm256_max_epu8(v, _mm256_set1_epi8(0x7F)), v);
+
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('/')));
+
+    return esc_mask32(v) | (uint32_t)_mm256_movemask_epi8(m);
+}
+
+AVX2_FUNC static const char*
+scan_escape_avx2(const char *s, const char *end) {
+    uintptr_t	off = (uintptr_t)s & 0x1F;
+    const char	*b = s - off;
+    uint32_t	m = esc_mask32(_mm256_load_si256((const __m256i*)b)) & (0xFFFFFFFF << off);
+
+    while (0 == m) {
+	b += 32;
+	if (end <= b) {
+	    return end;
+	}
+	m = esc_mask32(_mm256_load_si256((const __m256i*)b));
+    }
+    b += CTZ(m);
+
+    return (b < end) ? b : end;
+}
+
+AVX2_FUNC static const char*
+scan_escape_ascii_avx2(const char *s, const char *end) {
+    uintptr_t	off = (uintptr_t)s & 0x1F;
+    const char	*b = s - off;
+    uint32_t	m = esc_ascii_mask32(_mm256_load_si256((const __m256i*)b)) & (0xFFFFFFFF << off);
+
+    while (0 == m) {
+	b += 32;
+	if (end <= b) {
+	    return end;
+	}
+	m = esc_ascii_mask32(_mm256_load_si256((const __m256i*)b));
+    }
+    b += CTZ(m);
+
+    return (b < end) ? b : end;
+}
+
+AVX2_FUNC inline static uint32_t
+op_mask32(__m256i v) {
+    __m256i	l = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+    __m256i	m = _mm256_or_si256(_mm256_cmpeq_epi8(l, _mm256_set1_epi8('{')),
+				    _mm256_cmpeq_epi8(l, _mm256_set1_epi8('}')));
+
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(':')));
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(',')));
+
+    return (uint32_t)_mm256_movemask_epi8(m);
+}
+
+AVX2_FUNC inline static uint64_t
+eq_mask64(__m256i lo, __m256i hi, char c) {
+    __m256i	m = _mm256_set1_epi8(c);
+
+    return (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, m)) |
+	((uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, m)) << 32);
+}
+
+AVX2_FUNC static void
+classify_avx2(const char *s, Block b) {
+    __m256i	lo = _mm256_loadu_si256((const __m256i*)s);
+    __m256i	hi = _mm256_loadu_si256((const __m256i*)(s + 32));
+
+    b->quote = eq_mask64(lo, hi, '"');
+    b->bslash = eq_mask64(lo, hi, '\\');
+    b->slash = eq_mask64(lo, hi, '/');
+    b->white = (uint64_t)white_mask32(lo) | ((uint64_t)white_mask32(hi) << 32);
+    b->op = (uint64_t)op_mask32(lo) | ((uint64_t)op_mask32(hi) << 32);
+}
+#endif
+
+void
+oj_simd_init() {
+    oj_skip_white_run = skip_white_scalar;
+    oj_scan_string = scan_string_scalar;
+    oj_scan_nest = scan_nest_scalar;
+    oj_scan_escape = scan_escape_scalar;
+    oj_scan_escape_ascii = scan_escape_ascii_scalar;
+    classify_block = classify_scalar;
+#ifdef OJ_SSE2
+    oj_skip_white_run = skip_white_sse2;
+    oj_scan_string = scan_string_sse2;
+    oj_scan_nest = scan_nest_sse2;
+    oj_scan_escape = scan_escape_sse2;
+    oj_scan_escape_ascii = scan_escape_ascii_sse2;
+    classify_block = classify_sse2;
+#endif
+#ifdef OJ_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+	oj_skip_white_run = skip_white_avx2;
+	oj_scan_string = scan_string_avx2;
+	oj_scan_nest = scan_nest_avx2;
+	oj_scan_escape = scan_escape_avx2;
+	oj_scan_escape_ascii = scan_escape_ascii_avx2;
+	classify_block = classify_avx2;
+    }
+#endif
+}
+
+// Returns a pointer just past the '}' or ']' that closes the Hash or Array
+// opened at s, or 0 if the '\0' terminator is reached first. Brackets in
+// strings and comments are not counted. Nothing else is checked.
+const char*
+oj_skip_container(const char *s) {
+    int	depth = 0;
+
+    while (1) {
+	s = oj_scan_nest(s);
+	switch (*s) {
+	case '"':
+	    for (s = oj_scan_string(s + 1); '\\' == *s; s = oj_scan_string(s + 2)) {
+		if ('\0' == s[1]) {
+		    return 0;
+		}
+	    }
+	    if ('\0' == *s) {
+		return 0;
+	    }
+	    s++;
+	    break;
+	case '{':
+	case '[':
+	    depth++;
+	    s++;
+	    break;
+	case '}':
+	case ']':
+	    s++;
+	    if (0 == --depth) {
+		return s;
+	    }
+	    break;
+	case '/':
+	    s++;
+	    if ('*' == *s) {
+		for (s++; '\0' != *s && !('*' == *s && '/' == s[1]); s++) {
+		}
+		if ('\0' == *s) {
+		    return 0;
+		}
+		s += 2;
+	    } else if ('/' == *s) {
+		for (; '\0' != *s && '\n' != *s; s++) {
+		}
+	    }
+	    break;
+	default: // '\0'
+	    return 0;
+	}
+    }
+}
+
+// Returns the bits for characters that follow an unescaped backslash. The
+// carry is set when the block ends with an unescaped backslash. Backslashes
+// are rare outside of escaped strings so a loop over them is fine.
+inline static uint64_t
+escaped_bits(uint64_t bslash, uint64_t *carry) {
+    uint64_t	escaped = *carry;
+
+    *carry = 0;
+    bslash &= ~escaped;
+    while (0 != bslash) {
+	uint64_t	bit = bslash & (0 - bslash);
+	uint64_t	next = bit << 1;
+
+	if (0 == next) {
+	    *carry = 1;
+	}
+	escaped |= next;
+	bslash &= ~(bit | next);
+    }
+    return escaped;
+}
+
+// Each bit is set if there is an odd number of set bits at or below it. For
+// quote bits that marks the opening quote and the content of each string.
+inline static uint64_t
+prefix_xor(uint64_t x) {
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+
+    return x;
+}
+
+void
+oj_tape_init(Tape tape) {
+    tape->idx = 0;
+    tape->cnt = 0;
+    tape->size = 0;
+    tape->json = 0;
+    tape->len = 0;
+    tape->pos = 0;
+}
+
+void
+oj_tape_start(Tape tape, const char *json, size_t len) {
+    if (0 == tape->idx) {
+	tape->size = TAPE_WINDOW;
+	tape->idx = ALLOC_N(uint32_t, tape->size);
+    }
+    tape->cnt = 0;
+    tape->json = json;
+    tape->len = len;
+    tape->pos = 0;
+    tape->in_str = 0;
+    tape->esc_carry = 0;
+    tape->sep_carry = 1; // the start of the document acts like a separator
+    tape->stop = 0;
+}
+
+/* Stage one of the tape parser. Entries from from to the end of the tape
+ * are moved to the front and then the document is classified 64 bytes at a
+ * time, collecting the offsets of all structural characters, string starts,
+ * and scalar starts until the tape is full. Scalars are not split further.
+ * Whatever comes between two entries is validated by the parser when it
+ * walks the tape.
+ *
+ * Indexing stops at the block with a comment in it and sets stop. The
+ * parser then continues a byte at a time from the last entry.
+ */
+void
+oj_tape_fill(Tape tape, const uint32_t *from) {
+    struct _Block	b;
+    char		pad[64];
+    size_t		keep = tape->idx + tape->cnt - from;
+    uint32_t		*ip;
+
+    if (0 < keep && from != tape->idx) {
+	memmove(tape->idx, from, keep * sizeof(uint32_t));
+    }
+    ip = tape->idx + keep;
+    while (tape->pos < tape->len && ip + 64 <= tape->idx + tape->size) {
+	const char	*s = tape->json + tape->pos;
+	uint32_t	base = (uint32_t)tape->pos;
+	uint64_t	quote;
+	uint64_t	in_str;
+	uint64_t	esc_carry = tape->esc_carry;
+	uint64_t	sep;
+	uint64_t	bits;
+
+	if (tape->len - tape->pos < 64) {
+	    memset(pad, ' ', sizeof(pad));
+	    memcpy(pad, s, tape->len - tape->pos);
+	    classify_block(pad, &b);
+	} else {
+	    classify_block(s, &b);
+	}
+	quote = b.quote;
+	if (0 != b.bslash || 0 != esc_carry) {
+	    quote &= ~escaped_bits(b.bslash, &esc_carry);
+	}
+	in_str = prefix_xor(quote) ^ (0 - (tape->in_str >> 63));
+	if (0 != (b.slash & ~in_str)) {
+	    tape->stop = 1;
+	    break;
+	}
+	sep = b.white | b.op | quote;
+	bits = (b.op & ~in_str) | (quote & in_str) | (~(sep | in_str) & ((sep << 1) | tape->sep_carry));
+	for (; 0 != bits; bits &= bits - 1, ip++) {
+	    *ip = base + CTZ64(bits);
+	}
+	tape->in_str = in_str;
+	tape->esc_carry = esc_carry;
+	tape->sep_carry = sep >> 63;
+	tape->pos += 64;
+    }
+    tape->cnt = ip - tape->idx;
+}
+
+/* Indexes all of json in one go for a worker thread. The tape is allocated
+ * with malloc() since the thread does not hold the GVL and must be released
+ * with free(). Returns 0 if the memory could not be allocated.
+ */
+int
+oj_tape_index(Tape tape, const char *json, size_t len) {
+    tape->size = TAPE_WINDOW;
+    if (0 == (tape->idx = (uint32_t*)malloc(sizeof(uint32_t) * tape->size))) {
+	return 0;
+    }
+    tape->cnt = 0;
+    tape->json = json;
+    tape->len = len;
+    tape->pos = 0;
+    tape->in_str = 0;
+    tape->esc_carry = 0;
+    tape->sep_carry = 1;
+    tape->stop = 0;
+    while (1) {
+	uint32_t	*idx;
+
+	oj_tape_fill(tape, tape->idx);
+	if (tape->stop || len <= tape->pos) {
+	    break;
+	}
+	if (0 == (idx = (uint32_t*)realloc(tape->idx, sizeof(uint32_t) * tape->size * 2))) {
+	    free(tape->idx);
+	    tape->idx = 0;
+	    return 0;
+	}
+	tape->idx = idx;
+	tape->size *= 2;
+    }
+    return 1;
+}
+
+void
+oj_tape_cleanup(Tape tape) {
+    if (0 != tape->idx) {
+	xfree(tape->idx);
+	tape->idx = 0;
+    }
+}
@@ -0,0 +1,119 @@
+/* simd.h
+ * Copyright (c) 2013, Peter Ohler
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *  - Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ *  - Neither the name of Peter Ohler nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __OJ_SIMD_H__
+#define __OJ_SIMD_H__
+
+#include <stdint.h>
+
+// Vector kernels are picked once by oj_simd_init() based on what the CPU
+// supports. Each has a scalar fallback so the function pointers are always
+// valid after initialization.
+
+// Returns a pointer to the first character at or after s that is not JSON
+// white space. The '\0' terminator is not white so the scan always stops.
+extern const char*	(*oj_skip_white_run)(const char *s);
+
+// Returns a pointer to the first '"', '\\', or '\0' at or after s. Those are
+// the only characters that end a run of plain string content. Other control
+// characters are accepted in strings by the parsers so they do not stop the
+// scan.
+extern const char*	(*oj_scan_string)(const char *s);
+
+// Returns a pointer to the first '"', '{', '}', '[', ']', '/', or '\0' at or
+// after s. Those are the only characters that matter when passing over a
+// nested value without parsing it.
+extern const char*	(*oj_scan_nest)(const char *s);
+
+// Return a pointer to the first character from s up to end that has to be
+// escaped when dumped, or end if there are none. That is a control
+// character, '"', or '\\'. The ascii version also stops on '/', DEL, and any
+// character with the high bit set. Strings can hold a '\0' so the scan is
+// bounded by end rather than a terminator.
+extern const char*	(*oj_scan_escape)(const char *s, const char *end);
+extern const char*	(*oj_scan_escape_ascii)(const char *s, const char *end);
+
+// A structural index of a JSON document. Each entry is the offset of a
+// '{', '}', '[', ']', ':', or ',' outside of a string, an opening quote, or
+// the first character of a number or literal. The document is indexed a
+// window at a time so the entries and the text they point to are still in
+// cache when the parser gets to them.
+typedef struct _Tape {
+    uint32_t	*idx;
+    size_t	cnt;
+    size_t	size;
+    const char	*json;
+    size_t	len;
+    size_t	pos;		// bytes indexed so far
+    uint64_t	in_str;		// carries between 64 byte blocks
+    uint64_t	esc_carry;
+    uint64_t	sep_carry;
+    int		stop;		// set when a comment is reached
+} *Tape;
+
+extern void		oj_simd_init(void);
+extern const char*	oj_skip_container(const char *s);
+
+extern void		oj_tape_init(Tape tape);
+extern void		oj_tape_start(Tape tape, const char *json, size_t len);
+extern void		oj_tape_fill(Tape tape, const uint32_t *from);
+extern int		oj_tape_index(Tape tape, const char *json, size_t len);
+extern void		oj_tape_cleanup(Tape tape);
+
+inline static int
+is_white(char c) {
+    switch (c) {
+    case ' ':
+    case '\t':
+    case '\f':
+    case '\n':
+    case '\r':
+	return 1;
+    default:
+	break;
+    }
+    return 0;
+}
+
+// Most tokens are separated by nothing or by a single space so those cases
+// are checked inline before handing off to the vector scan.
+inline static const char*
+oj_skip_white(const char *s) {
+    if (!is_white(*s)) {
+	return s;
+    }
+    s++;
+    if (!is_white(*s)) {
+	return s;
+    }
+    return oj_skip_white_run(s + 1);
+}
+
+#endif /* __OJ_SIMD_H__ */
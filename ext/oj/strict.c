@@ -37,14 +37,11 @@
 #include "err.h"
 #include "parse.h"
 #include "encode.h"
+#include "hash.h"
 
 // Workaround in case INFINITY is not defined in math.h or if the OS is CentOS
 #define OJ_INFINITY (1.0/0.0)
 
-static void
-noop_end(struct _ParseInfo *pi) {
-}
-
 static void
 add_value(ParseInfo pi, VALUE val) {
     pi->stack.head->val = val;
@@ -52,10 +49,7 @@ add_value(ParseInfo pi, VALUE val) {
 
 static void
 add_cstr(ParseInfo pi, const char *str, size_t len, const char *orig) {
-    VALUE	rstr = rb_str_new(str, len);
-
-    rstr = oj_encode(rstr);
-    pi->stack.head->val = rstr;
+    pi->stack.head->val = oj_cstr_to_value(pi, str, len);
 }
 
 static void
@@ -63,72 +57,86 @@ add_num(ParseInfo pi, NumInfo ni) {
     pi->stack.head->val = oj_num_as_value(ni);
 }
 
+// An open array or hash holds the offset of its first child on the value
+// stack. The children collect there and the container is built in one step
+// when it closes so it is allocated at its final size.
 static VALUE
 start_hash(ParseInfo pi) {
-    return rb_hash_new();
+    return LONG2FIX(stack_vcnt(&pi->stack));
+}
+
+static void
+end_hash(ParseInfo pi) {
+    Val	parent = stack_peek(&pi->stack);
+
+    parent->val = oj_stack_hash(&pi->stack, FIX2LONG(parent->val));
 }
 
 static VALUE
 hash_key(ParseInfo pi, const char *key, size_t klen) {
-    VALUE	rkey = rb_str_new(key, klen);
-
-    rkey = oj_encode(rkey);
     if (Yes == pi->options.sym_key) {
-	rkey = rb_str_intern(rkey);
+	return oj_sym_cache_get(key, klen);
+    }
+    if (Yes == pi->options.cache_keys) {
+	return oj_key_cache_get(key, klen);
     }
-    return rkey;
+    return rb_str_freeze(oj_encode(rb_str_new(key, klen)));
 }
 
 static void
 hash_set_cstr(ParseInfo pi, const char *key, size_t klen, const char *str, size_t len, const char *orig) {
-    VALUE	rstr = rb_str_new(str, len);
-
-    rstr = oj_encode(rstr);
-    rb_hash_aset(stack_peek(&pi->stack)->val, hash_key(pi, key, klen), rstr);
+    stack_add(&pi->stack, hash_key(pi, key, klen));
+    stack_add(&pi->stack, oj_cstr_to_value(pi, str, len));
 }
 
 static void
 hash_set_num(struct _ParseInfo *pi, const char *key, size_t klen, NumInfo ni) {
-    rb_hash_aset(stack_peek(&pi->stack)->val, hash_key(pi, key, klen), oj_num_as_value(ni));
+    stack_add(&pi->stack, hash_key(pi, key, klen));
+    stack_add(&pi->stack, oj_num_as_value(ni));
 }
 
 static void
 hash_set_value(ParseInfo pi, const char *key, size_t klen, VALUE value) {
-    rb_hash_aset(stack_peek(&pi->stack)->val, hash_key(pi, key, klen), value);
+    stack_add(&pi->stack, hash_key(pi, key, klen));
+    stack_add(&pi->stack, value);
 }
 
 static VALUE
 start_array(ParseInfo pi) {
-    return rb_ary_new();
+    return LONG2FIX(stack_vcnt(&pi->stack));
 }
 
 static void
-array_append_cstr(ParseInfo pi, const char *str, size_t len, const char *orig) {
-    VALUE	rstr = rb_str_new(str, len);
+end_array(ParseInfo pi) {
+    Val	parent = stack_peek(&pi->stack);
 
-    rstr = oj_encode(rstr);
-    rb_ary_push(stack_peek(&pi->stack)->val, rstr);
+    parent->val = oj_stack_array(&pi->stack, FIX2LONG(parent->val));
+}
+
+static void
+array_append_cstr(ParseInfo pi, const char *str, size_t len, const char *orig) {
+    stack_add(&pi->stack, oj_cstr_to_value(pi, str, len));
 }
 
 static void
 array_append_num(ParseInfo pi, NumInfo ni) {
-    rb_ary_push(stack_peek(&pi->stack)->val, oj_num_as_value(ni));
+    stack_add(&pi->stack, oj_num_as_value(ni));
 }
 
 static void
 array_append_value(ParseInfo pi, VALUE value) {
-    rb_ary_push(stack_peek(&pi->stack)->val, value);
+    stack_add(&pi->stack, value);
 }
 
 void
 oj_set_strict_callbacks(ParseInfo pi) {
     pi->start_hash = start_hash;
-    pi->end_hash = noop_end;
+    pi->end_hash = end_hash;
     pi->hash_set_cstr = hash_set_cstr;
     pi->hash_set_num = hash_set_num;
     pi->hash_set_value = hash_set_value;
     pi->start_array = start_array;
-    pi->end_array = noop_end;
+    pi->end_array = end_array;
     pi->array_append_cstr = array_append_cstr;
     pi->array_append_num = array_append_num;
     pi->array_append_value = array_append_value;
@@ -145,15 +153,15 @@ oj_strict_parse(int argc, VALUE *argv, VALUE self) {
     pi.options = oj_default_options;
     oj_set_strict_callbacks(&pi);
 
-    return oj_pi_parse(argc, argv, &pi, 0);
+    return oj_pi_parse(argc, argv, &pi, 0, 0);
 }
 
 VALUE
-oj_strict_parse_cstr(int argc, VALUE *argv, char *json) {
+oj_strict_parse_cstr(int argc, VALUE *argv, char *json, size_t len) {
     struct _ParseInfo	pi;
 
     pi.options = oj_default_options;
     oj_set_strict_callbacks(&pi);
 
-    return oj_pi_parse(argc, argv, &pi, json);
+    return oj_pi_parse(argc, argv, &pi, json, len);
 }
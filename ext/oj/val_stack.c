@@ -46,3 +46,43 @@ oj_stack_next_string(ValNext n) {
     }
     return "nothing";
 }
+
+// Builds an Array from the children added since start and drops them from
+// the stack.
+VALUE
+oj_stack_array(ValStack stack, long start) {
+    VALUE	a = rb_ary_new4(stack_vcnt(stack) - start, stack->vals + start);
+
+    stack->vtail = stack->vals + start;
+
+    return a;
+}
+
+// Builds a Hash from the key and value pairs added since start and drops
+// them from the stack. Keys are already frozen so they can be inserted as is.
+VALUE
+oj_stack_hash(ValStack stack, long start) {
+    long	cnt = stack_vcnt(stack) - start;
+    VALUE	*vp = stack->vals + start;
+    VALUE	h;
+
+#if HAS_HASH_NEW_CAPA
+    h = rb_hash_new_capa(cnt / 2);
+#else
+    h = rb_hash_new();
+#endif
+#if HAS_HASH_BULK_INSERT
+    rb_hash_bulk_insert(cnt, vp, h);
+#else
+    {
+	VALUE	*end = vp + cnt;
+
+	for (; vp < end; vp += 2) {
+	    rb_hash_aset(h, *vp, vp[1]);
+	}
+    }
+#endif
+    stack->vtail = stack->vals + start;
+
+    return h;
+}
@@ -36,6 +36,7 @@
 #include <stdint.h>
 
 #define STACK_INC	32
+#define VALS_INC	256
 
 typedef enum {
     NEXT_NONE		= 0,
@@ -52,10 +53,8 @@ typedef enum {
 typedef struct _Val {
     VALUE	val;
     const char	*key;
-    union {
-	const char	*classname;
-	OddArgs		odd_args;
-    };
+    const char	*classname;
+    OddArgs	odd_args;	// kept apart from classname so GC can mark the args
     uint16_t	klen;
     uint16_t	clen;
     char	next; // ValNext
@@ -67,6 +66,12 @@ typedef struct _ValStack {
     Val		head;	// current stack
     Val		end;	// stack end
     Val		tail;	// pointer to one past last element name on stack
+    // Children of the open containers, in document order, waiting for their
+    // container to close so it can be built at its final size.
+    VALUE	*vals;
+    VALUE	*vtail;
+    VALUE	*vend;
+    VALUE	vbase[VALS_INC];
 } *ValStack;
 
 inline static void
@@ -77,10 +82,28 @@ stack_init(ValStack stack) {
     stack->head->val = Qundef;
     stack->head->key = 0;
     stack->head->classname = 0;
+    stack->head->odd_args = 0;
     stack->head->klen = 0;
     stack->head->clen = 0;
     stack->head->next = NEXT_NONE;
     //stack->head->type = TYPE_NONE;
+    stack->vals = stack->vbase;
+    stack->vtail = stack->vals;
+    stack->vend = stack->vbase + VALS_INC;
+}
+
+// Empties the stack but keeps the memory it has grown into.
+inline static void
+stack_reset(ValStack stack) {
+    stack->tail = stack->head;
+    stack->head->val = Qundef;
+    stack->head->key = 0;
+    stack->head->classname = 0;
+    stack->head->odd_args = 0;
+    stack->head->klen = 0;
+    stack->head->clen = 0;
+    stack->head->next = NEXT_NONE;
+    stack->vtail = stack->vals;
 }
 
 inline static int
@@ -93,6 +116,9 @@ stack_cleanup(ValStack stack) {
     if (stack->base != stack->head) {
         xfree(stack->head);
     }
+    if (stack->vbase != stack->vals) {
+        xfree(stack->vals);
+    }
 }
 
 inline static void
@@ -113,6 +139,7 @@ stack_push(ValStack stack, VALUE val, ValNext next) {
     stack->tail->val = val;
     stack->tail->next = next;
     stack->tail->classname = 0;
+    stack->tail->odd_args = 0;
     stack->tail->key = 0;
     stack->tail->clen = 0;
     stack->tail->klen = 0;
@@ -120,6 +147,29 @@ stack_push(ValStack stack, VALUE val, ValNext next) {
     stack->tail++;
 }
 
+inline static void
+stack_add(ValStack stack, VALUE val) {
+    if (stack->vend <= stack->vtail) {
+	size_t	len = stack->vend - stack->vals;
+
+	if (stack->vbase == stack->vals) {
+	    stack->vals = ALLOC_N(VALUE, len * 2);
+	    memcpy(stack->vals, stack->vbase, sizeof(VALUE) * len);
+	} else {
+	    REALLOC_N(stack->vals, VALUE, len * 2);
+	}
+	stack->vtail = stack->vals + len;
+	stack->vend = stack->vals + len * 2;
+    }
+    *stack->vtail++ = val;
+}
+
+// Offset of the next child added, kept by a container while it is open.
+inline static long
+stack_vcnt(ValStack stack) {
+    return (long)(stack->vtail - stack->vals);
+}
+
 inline static size_t
 stack_size(ValStack stack) {
     return stack->tail - stack->head;
@@ -164,5 +214,7 @@ stack_pop(ValStack stack) {
 }
 
 extern const char*	oj_stack_next_string(ValNext n);
+extern VALUE		oj_stack_array(ValStack stack, long start);
+extern VALUE		oj_stack_hash(ValStack stack, long start);
 
 #endif /* __OJ_VAL_STACK_H__ */
@@ -34,6 +34,10 @@ module Oj
   #    def add_value(value, key); end
   #    def error(message, line, column); end
   #
+  # If hash_start() or array_start() returns Oj::SKIP the Hash or Array is
+  # passed over without being parsed. No other methods are called for it or
+  # for anything in it, including hash_end() or array_end().
+  #
   class Saj
     # Create a new instance of the Saj handler class.
     def initialize()
@@ -35,6 +35,11 @@ module Oj
   #    def add_value(value); end
   #    def error(message, line, column); end
   #
+  # If hash_start() or array_start() returns Oj::SKIP the Hash or Array is
+  # passed over without being parsed. No other methods are called for it or
+  # for anything in it, including hash_end() or array_end(), and it is not
+  # added to its parent.
+  #
   class ScHandler
     # Create a new instance of the ScHandler class.
     def initialize()
@@ -81,8 +81,7 @@ class DocTest < ::Test::Unit::TestCase
     json = %{12345.6789e7}
     Oj::Doc.open(json) do |doc|
       assert_equal(Float, doc.type)
-      #assert_equal(12345.6789e7, doc.fetch())
-      assert_equal(12345.6789e7.to_i, doc.fetch().to_i)
+      assert_equal(12345.6789e7, doc.fetch())
     end
   end
 
@@ -413,4 +412,36 @@ class DocTest < ::Test::Unit::TestCase
     assert_equal({'/x' => true, '/y' => 58, '/z/1' => 1, '/z/2' => 2, '/z/3' => 3}, results)
   end
 
+  def test_lazy_load
+    json = %{{"id":7,"user":{"name":"Ann","tags":["a","b"]},"items":[1,2.5,null,{"x":"y"}]}}
+    h = Oj.load(json, :lazy => true)
+    assert_equal(Oj::LazyHash, h.class)
+    assert_equal(7, h['id'])
+    assert_equal('Ann', h.dig(:user, 'name'))
+    assert_equal('y', h.dig('items', -1, 'x'))
+    assert_equal(nil, h['none'])
+    assert_equal(['id', 'user', 'items'], h.keys)
+    assert_equal(Oj::LazyArray, h['items'].class)
+    assert_equal(4, h['items'].size)
+    assert_equal(Oj.load(json, :mode => :strict), h.to_h)
+    assert_raise(Oj::ParseError) { Oj.load('{"a":[1}', :lazy => true) }
+
+    ['[1e5,-2E-3,1e+300]',
+     '[0.1234567890123456789012345,12345678901234567890123]',
+     '["a\u0000b","é𝄞"]'].each { |j|
+      assert_equal(Oj.load(j, :mode => :strict), Oj.load(j, :lazy => true).to_a)
+    }
+    json = '{"a":1,"k\u0000x":2,"a":3}'
+    h = Oj.load(json, :lazy => true)
+    assert_equal(Oj.load(json, :mode => :strict), h.to_h)
+    assert_nil(h["a\u0000zz"])
+    assert_equal(2, h["k\u0000x"])
+    assert_equal(3, h['a'])
+    assert_equal(2, h.size)
+    assert_equal(['a', "k\u0000x"], h.keys)
+    pairs = []
+    h.each { |k, v| pairs << [k, v] }
+    assert_equal([['a', 3], ["k\u0000x", 2]], pairs)
+  end
+
 end # DocTest
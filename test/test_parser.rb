@@ -0,0 +1,53 @@
+#!/usr/bin/env ruby
+# encoding: UTF-8
+
+# Ubuntu does not accept arguments to ruby when called using env. To get warnings to show up the -w options is
+# required. That can be set in the RUBYOPT environment variable.
+# export RUBYOPT=-w
+
+$VERBOSE = true
+
+$: << File.join(File.dirname(__FILE__), "../lib")
+$: << File.join(File.dirname(__FILE__), "../ext")
+
+require 'test/unit'
+require 'oj'
+
+class ParserTest < ::Test::Unit::TestCase
+
+  def test_push_parser
+    docs = []
+    parser = Oj::Parser.new(:mode => :strict) { |doc| docs << doc }
+    '{"a\\u00e9b":[12,"t\\"w'.each_char { |c| parser << c }
+    parser << 'o",-3.5e2,tr'
+    parser << 'ue,null]} 17 /* c'
+    parser << ' */ 4'
+    parser.finish
+    assert_equal([{ "a\u00e9b" => [12, 't"wo', -350.0, true, nil] }, 17, 4], docs)
+    parser = Oj::Parser.new(:mode => :strict) { |doc| }
+    parser << '[1,'
+    assert_raise(Oj::ParseError) { parser.finish }
+    parser = Oj::Parser.new(:mode => :strict) { |doc| }
+    assert_raise(Oj::ParseError) { parser << '[1,}' }
+  end
+
+  def test_parser_reuse
+    p = Oj::Parser.new(:mode => :compat, :symbol_keys => true)
+    assert_equal({ :a => [1, 2] }, p.parse('{"a":[1,2]}'))
+    assert_equal([[[[7]]]], p.parse('[[[[7]]]]'))
+    assert_raise(Oj::ParseError) { p.parse('{"a":') }
+    assert_equal({ :b => nil }, p.parse('{"b":null}'))
+    assert_raise(ArgumentError) { p << '[1]' }
+  end
+
+  def test_escaped_keys
+    json = %{{"a\\u00e9":{"t\\tb":[1,{"q\\"":2}]},"#{'x' * 2000}\\n":3}}
+    expected = { "a\u00e9" => { "t\tb" => [1, { 'q"' => 2 }] }, "#{'x' * 2000}\n" => 3 }
+    docs = []
+    parser = Oj::Parser.new(:mode => :strict) { |doc| docs << doc }
+    json.each_char { |c| parser << c }
+    parser.finish
+    assert_equal([expected], docs)
+  end
+
+end
@@ -46,6 +46,9 @@ class StrictJuice < ::Test::Unit::TestCase
     dump_and_load(12345, false)
     dump_and_load(-54321, false)
     dump_and_load(1, false)
+    dump_and_load(1234567890123456789, false)
+    dump_and_load(-9223372036854775807, false)
+    dump_and_load(12345678901234567890, false)
   end
 
   def test_float
@@ -58,6 +61,13 @@ class StrictJuice < ::Test::Unit::TestCase
     dump_and_load(-2.48e100 * 1.0e10, false)
   end
 
+  def test_float_exact
+    json = '[0.1,0.3,70.35,1.7976931348623157e308,2.2250738585072014e-308,123456789.12345678,-8.98846567431158e-300,5e-324]'
+    obj = Oj.strict_load(json)
+    assert_equal([0.1, 0.3, 70.35, 1.7976931348623157e308, 2.2250738585072014e-308, 123456789.12345678, -8.98846567431158e-300, 5e-324], obj)
+    assert_equal(Float, obj[5].class)
+  end
+
   def test_string
     dump_and_load('', false)
     dump_and_load('abc', false)
@@ -144,6 +154,101 @@ class StrictJuice < ::Test::Unit::TestCase
     assert_equal({"a\nb" => true, "c\td" => false}, obj)
   end
 
+  def test_string_escaped_runs
+    # long plain runs on either side of escapes
+    key = "k#{'a' * 40}\n#{'b' * 70}\t"
+    str = "#{'x' * 33}\"#{'y' * 65}\\#{'z' * 17}"
+    json = %{{"k#{'a' * 40}\\n#{'b' * 70}\\t":"#{'x' * 33}\\"#{'y' * 65}\\\\#{'z' * 17}"}}
+    obj = Oj.strict_load(json)
+    assert_equal({key => str}, obj)
+  end
+
+  def test_tape
+    obj = (0...200).map { |i| { "id#{i}" => [i, -i * 1.5, "s\"#{i}", true, false, nil, {}, []] } }
+    json = Oj.dump(obj, :mode => :strict, :indent => 2)
+    assert_equal(obj, Oj.load(json, :mode => :strict, :tape => true))
+    json = json.sub('"id100"', "/* comment */ \"id100\"")
+    assert_equal(obj, Oj.load(json, :mode => :strict, :tape => true))
+    assert_raise(Oj::ParseError) { Oj.load('[1x, 2]', :mode => :strict, :tape => true) }
+  end
+
+  def test_slice
+    json = %{xx[1,"two",3.5]yy 1}
+    assert_equal([1, 'two', 3.5], Oj.load(json, :mode => :strict, :offset => 2, :length => 13))
+    assert_equal([1, 'two', 3.5], Oj.load(json, :mode => :strict, :offset => 2, :length => 13, :tape => true))
+    assert_equal(12, Oj.load('12345', :mode => :strict, :length => 2))
+    assert_equal('ab', Oj.load('"ab"c"', :mode => :strict, :length => 4))
+    assert_raise(Oj::ParseError) { Oj.load('"ab"', :mode => :strict, :length => 3) }
+    assert_raise(Oj::ParseError) { Oj.load('true', :mode => :strict, :length => 3) }
+    assert_raise(ArgumentError) { Oj.load('[1]', :mode => :strict, :offset => 1, :length => 3) }
+  end
+
+  def test_cache_keys
+    docs = Oj.load('[{"name":1,"b\u00e9ta":2},{"name":3,"b\u00e9ta":4}]', :mode => :strict)
+    assert(docs[0].keys[0].equal?(docs[1].keys[0]))
+    assert(docs[0].keys[1].frozen?)
+    assert_equal("b\u00e9ta", docs[1].keys[1])
+    docs = Oj.load('[{"name":1},{"name":2}]', :mode => :compat, :cache_keys => false)
+    assert_equal([{ 'name' => 1 }, { 'name' => 2 }], docs)
+    json = '{' + (1..5000).map { |i| %{"k#{i}":#{i}} }.join(',') + '}'
+    assert(Oj.load(json, :mode => :strict).all? { |k, v| "k#{v}" == k })
+  end
+
+  def test_symbol_keys_cache
+    docs = Oj.load('[{"name":1,"b\u00e9ta":2},{"name":3,"unseen_key_q7":4}]', :mode => :strict, :symbol_keys => true)
+    assert_equal([{ :name => 1, :"b\u00e9ta" => 2 }, { :name => 3, :unseen_key_q7 => 4 }], docs)
+    json = '{' + (1..5000).map { |i| %{"s#{i}":#{i}} }.join(',') + '}'
+    assert(Oj.load(json, :mode => :compat, :symbol_keys => true).all? { |k, v| :"s#{v}" == k })
+  end
+
+  def test_cache_str
+    docs = Oj.load('["USD",{"c":"USD","d":"not a short value"}]', :mode => :strict, :cache_str => 8)
+    assert(docs[0].equal?(docs[1]['c']))
+    assert(docs[0].frozen?)
+    assert(!docs[1]['d'].frozen?)
+    docs = Oj.load('["USD","USD"]', :mode => :strict)
+    assert(!docs[0].equal?(docs[1]))
+    assert_raise(ArgumentError) { Oj.load('"x"', :mode => :strict, :cache_str => 'x') }
+  end
+
+  def test_escaped_keys
+    json = %{{"a\\u00e9":{"t\\tb":[1,{"q\\"":2}]},"#{'x' * 2000}\\n":3}}
+    expected = { "a\u00e9" => { "t\tb" => [1, { 'q"' => 2 }] }, "#{'x' * 2000}\n" => 3 }
+    assert_equal(expected, Oj.load(json, :mode => :strict))
+  end
+
+  def test_gc_during_parse
+    json = '[' + (1..20).map { |i| %{{"k#{i}":["v#{i}",{"x":[#{i},null]}]}} }.join(',') + ']'
+    expected = Oj.load(json, :mode => :strict)
+    GC.stress = true
+    begin
+      assert_equal(expected, Oj.load(json, :mode => :strict))
+      assert_equal(expected, Oj.load(json, :mode => :compat))
+    ensure
+      GC.stress = false
+    end
+  end
+
+  def test_wide_containers
+    json = '{' + (1..600).map { |i| %{"k#{i}":[#{(1..i % 40).to_a.join(',')}]} }.join(',') + ',"k1":null}'
+    doc = Oj.load(json, :mode => :strict, :cache_keys => false)
+    assert_equal(600, doc.size)
+    assert_equal(nil, doc['k1'])
+    assert_equal((1..39).to_a, doc['k39'])
+    assert(doc.keys.all? { |k| k.frozen? })
+    assert_equal([1, [2, 3]], Oj.load('[1,[2,3]', :mode => :strict))
+  end
+
+  def test_only_paths
+    json = '{"user":{"id":5,"name":"a]}\\\\\\""},"items":[{"sku":"a1","n":[1]},{"sku":"b2"}],"id":9}'
+    assert_equal({'user' => {'id' => 5}, 'items' => [{'sku' => 'a1'}, {'sku' => 'b2'}]},
+                 Oj.load(json, :mode => :strict, :only => ['/user/id', '/items/*/sku']))
+    assert_equal({'items' => [{'sku' => 'b2'}], 'id' => 9},
+                 Oj.load(json, :mode => :compat, :only => ['items/2', 'id']))
+    assert_raise(ArgumentError) { Oj.load(json, :mode => :strict, :only => ['/user/../id']) }
+    assert_raise(Oj::ParseError) { Oj.load('{"a":[1,"x', :mode => :strict, :only => ['/b']) }
+  end
+
   def test_bignum_object
     dump_and_load(7 ** 55, false)
   end
@@ -111,6 +111,7 @@ class Juice < ::Test::Unit::TestCase
     opts = Oj.default_options()
     assert_equal({ :indent=>0,
                    :second_precision=>9,
+                   :float_precision=>0,
                    :circular=>false,
                    :auto_define=>false,
                    :symbol_keys=>false,
@@ -120,6 +121,9 @@ class Juice < ::Test::Unit::TestCase
                    :time_format=>:unix,
                    :bigdecimal_as_decimal=>true,
                    :bigdecimal_load=>false,
+                   :tape=>false,
+                   :cache_keys=>true,
+                   :cache_str=>0,
                    :create_id=>'json_class'}, opts)
   end
 
@@ -127,6 +131,7 @@ class Juice < ::Test::Unit::TestCase
     orig = {
       :indent=>0,
       :second_precision=>9,
+      :float_precision=>0,
       :circular=>false,
       :auto_define=>false,
       :symbol_keys=>false,
@@ -136,10 +141,14 @@ class Juice < ::Test::Unit::TestCase
       :time_format=>:unix,
       :bigdecimal_as_decimal=>true,
       :bigdecimal_load=>false,
+      :tape=>false,
+      :cache_keys=>true,
+      :cache_str=>0,
       :create_id=>'json_class'}
     o2 = {
       :indent=>4,
       :second_precision=>7,
+      :float_precision=>15,
       :circular=>true,
       :auto_define=>true,
       :symbol_keys=>true,
@@ -149,6 +158,9 @@ class Juice < ::Test::Unit::TestCase
       :time_format=>:ruby,
       :bigdecimal_as_decimal=>false,
       :bigdecimal_load=>true,
+      :tape=>true,
+      :cache_keys=>false,
+      :cache_str=>5,
       :create_id=>nil}
     o3 = { :indent => 4 }
     Oj.default_options = o2
@@ -158,6 +170,25 @@ class Juice < ::Test::Unit::TestCase
     Oj.default_options = orig # return to original
   end
 
+  def test_compiled_options
+    opts = Oj::Options.new(:mode => :strict, :symbol_keys => true, :indent => 1)
+    assert(opts.frozen?)
+    assert_equal({ :a => [1, 2] }, Oj.load('{"a":[1,2]}', opts))
+    assert_equal(%{{\n "a":true\n}}, Oj.dump({ 'a' => true }, opts))
+    assert_equal([{ :b => nil }], Oj.load_lines('{"b":null}', opts).to_a)
+    assert_raise(ArgumentError) { Oj::Options.new(:mode => :other) }
+  end
+
+  def test_compiled_options_create_id
+    orig = Oj.default_options
+    Oj.default_options = { :create_id => 'abc' }
+    3.times { Oj::Options.new(:create_id => nil) }
+    3.times { Oj::Options.new(:create_id => 'xyz') }
+    GC.start
+    assert_equal('abc', Oj.default_options[:create_id])
+    Oj.default_options = orig # return to original
+  end
+
   def test_nil
     dump_and_load(nil, false)
   end
@@ -177,6 +208,13 @@ class Juice < ::Test::Unit::TestCase
     dump_and_load(1, false)
   end
 
+  def test_fixnum_digits
+    nums = [0, -1]
+    (0..18).each { |e| nums.concat([10**e - 1, 10**e, -(10**e)]) }
+    nums << 2**62 - 1 << -(2**62)
+    assert_equal("[#{nums.map(&:to_s).join(',')}]", Oj.dump(nums, :mode => :strict))
+  end
+
   def test_float
     dump_and_load(0.0, false)
     dump_and_load(12345.6789, false)
@@ -187,6 +225,26 @@ class Juice < ::Test::Unit::TestCase
     dump_and_load(-2.48e100 * 1.0e10, false)
   end
 
+  def test_float_round_trip
+    [0.1, 1.0/3, -0.021514578159012913, 2.2250738585072014e-308, 5e-324,
+     1.7976931348623157e308, 123456789012345680.0, 1e-7, 9007199254740993.0].each do |f|
+      json = Oj.dump(f, :mode => :strict)
+      assert_equal(f, Oj.load(json, :mode => :strict), json)
+      assert_equal(Float, Oj.load(json, :mode => :strict).class, json)
+    end
+    assert_equal('[100.0,0.0001,1.5e-07,1e+20]', Oj.dump([100.0, 0.0001, 1.5e-7, 1e20], :mode => :strict))
+    # Grisu2 alone gives 9.999999999999999e+22 and the like for these
+    assert_equal('[1e+23,8.41e+21,7.2573e+135,7.402e+21]', Oj.dump([1e23, 8.41e21, 7.2573e135, 7.402e21], :mode => :strict))
+    assert_equal('0.333333333333333', Oj.dump(1.0/3, :mode => :strict, :float_precision => 15))
+  end
+
+  def test_long_fraction
+    # leading zeros in a long fraction must not overflow the divisor
+    ['0.00034879201384710755', '0.00000000000000000012345', '-0.0000000000000000000000001'].each do |s|
+      assert_equal(Float(s), Oj.load(s, :mode => :strict).to_f, s)
+    end
+  end
+
   def test_string
     dump_and_load('', false)
     dump_and_load('abc', false)
@@ -194,6 +252,15 @@ class Juice < ::Test::Unit::TestCase
     dump_and_load("a\u0041", false)
   end
 
+  def test_escape_long
+    # escapes at every offset within and across vector blocks
+    (0..70).each do |i|
+      str = "#{'x' * i}\"\\/\n\u0001\u007fé#{'y' * i}\u0000"
+      assert_equal(str, Oj.load(Oj.dump(str, :mode => :strict), :mode => :strict))
+      assert_equal(str, Oj.load(Oj.dump(str, :mode => :strict, :ascii_only => true), :mode => :strict))
+    end
+  end
+
   def test_string_object
     dump_and_load('abc', false)
     dump_and_load(':abc', false)
@@ -728,6 +795,16 @@ class Juice < ::Test::Unit::TestCase
     end
   end
 
+  def test_range_object_gc
+    json = '[{"^O":"Range","begin":1,"end":3,"exclude_end?":false},{"^O":"Range","begin":2,"end":4,"exclude_end?":true}]'
+    GC.stress = true
+    begin
+      assert_equal([1..3, 2...4], Oj.load(json, :mode => :object))
+    ensure
+      GC.stress = false
+    end
+  end
+
   # BigNum
   def test_bignum_strict
     json = Oj.dump(7 ** 55, :mode => :strict)
@@ -958,6 +1035,54 @@ class Juice < ::Test::Unit::TestCase
     assert_equal({ 'x' => true, 'y' => 58, 'z' => [1, 2, 3]}, obj)
   end
 
+  def test_load_file
+    filename = 'open_file_test.json'
+    [%{{"a":[1,2,3]}}, %{[#{' ' * 4093}1]}].each do |json|
+      File.open(filename, 'w') { |f| f.write(json) }
+      assert_equal(Oj.load(json, :mode => :strict), Oj.load_file(filename, :mode => :strict))
+      assert_equal(Oj.load(json, :mode => :strict), Oj.load_file(filename, :mode => :strict, :mmap => false))
+    end
+  end
+
+  def test_io_pipe
+    r, w = IO.pipe
+    writer = Thread.new do
+      w.write('[')
+      20000.times { |i| w.write(%{{"i":#{i}},}) }
+      w.write('null]')
+      w.close
+    end
+    obj = Oj.strict_load(r)
+    writer.join
+    r.close
+    assert_equal(20001, obj.size)
+    assert_equal({ 'i' => 19999 }, obj[19999])
+  end
+
+  def test_load_lines
+    json = %{{"a":1}\n[2,3]\n"x" 4\n}
+    docs = []
+    assert_nil(Oj.load(json, :mode => :strict) { |doc| docs << doc })
+    assert_equal([{ 'a' => 1 }, [2, 3], 'x', 4], docs)
+    assert_equal([{ 'a' => 1 }, [2, 3], 'x', 4], Oj.load_lines(json, :mode => :strict, :tape => true).to_a)
+    assert_raise(Oj::ParseError) { Oj.load_lines("1\n[2,\n", :mode => :strict) { |doc| } }
+  end
+
+  def test_load_lines_escaped_keys
+    json = %{{"a\\u00e9":{"t\\tb":[1,{"q\\"":2}]},"#{'x' * 2000}\\n":3}}
+    expected = { "a\u00e9" => { "t\tb" => [1, { 'q"' => 2 }] }, "#{'x' * 2000}\n" => 3 }
+    assert_equal([expected] * 3, Oj.load_lines([json] * 3 * "\n", :mode => :compat).to_a)
+  end
+
+  def test_load_lines_threads
+    lines = (1..20000).map { |i| %{{"id":#{i},"tags":["a","b"],"x":#{i}.5}} }
+    ids = []
+    Oj.load_lines(lines.join("\n"), :mode => :strict, :threads => 3) { |doc| ids << doc['id'] }
+    assert_equal((1..20000).to_a, ids)
+    lines[15000] = '{"id":}'
+    assert_raise(Oj::ParseError) { Oj.load_lines(lines.join("\n"), :mode => :strict, :threads => 3) { |doc| } }
+  end
+
 # symbol_keys option
   def test_symbol_keys
     json = %{{